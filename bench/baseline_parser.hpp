@@ -0,0 +1,97 @@
+#ifndef FAUCET_BENCH_BASELINE_PARSER_HPP
+#define FAUCET_BENCH_BASELINE_PARSER_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "utils.hpp"
+
+/**
+ * The parser which `SimpleHttpMessageParser` replaced, kept verbatim apart from its name and the debug log so that
+ * the benchmarks can compare both. Every write rescans the whole message from its first byte.
+ */
+class BaselineHttpMessageParser {
+public:
+    bool Write(std::string const& msg) {
+        m_content += msg;
+        return Parse();
+    }
+
+    bool ReadHeader(std::string const& name, std::string& out) const {
+        auto i = m_props.find(ToLowerCase(name));
+        if (i == std::end(m_props)) {
+            return false;
+        }
+        out = i->second;
+        return true;
+    }
+
+    std::string ReadBody() const { return m_body; }
+
+    std::string ReadMethodType() const { return m_method_type; }
+
+private:
+    void AnalyzeLine(std::string const& line) {
+        auto pos = line.find_first_of(':');
+        if (pos == std::string::npos) {
+            // Analyze method type
+            if (m_method_type.empty()) {
+                auto p2 = line.find_first_of(' ');
+                m_method_type = line.substr(0, p2);
+            }
+            m_lines.push_back(line);
+            return;
+        }
+        std::string name = ToLowerCase(line.substr(0, pos));
+        std::string value = TrimLeftString(line.substr(pos + 1));
+        m_props[name] = value;
+    }
+
+    bool Parse() {
+        auto analyze_from = std::begin(m_content);
+        auto p = analyze_from;
+        while (p != std::end(m_content)) {
+            if (*p == '\r') {
+                ++p;
+                if (*p == '\n') {
+                    ++p;
+                    // cut current line
+                    std::string line(analyze_from, p - 2);
+                    if (line.empty()) {
+                        // end of header, following bytes are the content, read length
+                        std::string length_str;
+                        if (ReadHeader("Content-Length", length_str)) {
+                            int length = std::stoi(length_str);
+                            std::string content(p, std::end(m_content));
+                            if (content.size() < static_cast<std::size_t>(length)) {
+                                // wrong content
+                                return false;
+                            }
+                            m_body = std::move(content);
+                            return true;
+                        } else {
+                            // cannot find the `Content-Length', there is no data, just return
+                            return true;
+                        }
+                    } else {
+                        AnalyzeLine(line);
+                        analyze_from = p;
+                    }
+                }
+            } else {
+                ++p;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::string m_content;
+    std::vector<std::string> m_lines;
+    std::map<std::string, std::string> m_props;
+    std::string m_body;
+    std::string m_method_type;
+};
+
+#endif
@@ -0,0 +1,191 @@
+#include <benchmark/benchmark.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "faucet_addr_man.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::chrono::seconds const EXPIRY(24 * 60 * 60);
+
+std::size_t const NUM_QUERIES = 1 << 16;
+
+std::size_t const NUM_UPDATES = 1 << 20;
+
+std::string MakeAddress(char const* prefix, uint64_t index) {
+    char buf[64];
+    // zero padded, so the addresses are generated in ascending order
+    snprintf(buf, sizeof(buf), "tb1q%s%032llu", prefix, static_cast<unsigned long long>(index));
+    return buf;
+}
+
+/// A db file holding `num` records funded long before the cooldown window, it is removed with the directory
+struct Archive {
+    fs::path dir;
+    std::string db_path;
+
+    Archive(std::string const& name, uint64_t num) {
+        dir = fs::temp_directory_path() / ("faucet-bench-" + std::to_string(getpid()) + "-" + name);
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        db_path = (dir / "faucet-db.bin").string();
+        AddrSnapshot::Writer writer(db_path);
+        int64_t time = ::time(nullptr) - EXPIRY.count() * 30;
+        for (uint64_t i = 0; i < num; ++i) {
+            writer.Add(MakeAddress("", i), time);
+        }
+        writer.Commit();
+    }
+
+    ~Archive() { fs::remove_all(dir); }
+};
+
+/// The opened address manager of an archive, they are built once for each size and shared by the benchmarks
+struct Env {
+    Archive archive;
+    FaucetAddrMan addr_man{EXPIRY};
+
+    Env(std::string const& name, uint64_t num) : archive(name, num) {
+        addr_man.Open(archive.db_path, std::chrono::milliseconds(1000), std::chrono::hours(24));
+    }
+};
+
+Env& GetEnv(uint64_t num) {
+    static std::map<uint64_t, std::unique_ptr<Env>> envs;
+    auto& env = envs[num];
+    if (!env) {
+        env = std::make_unique<Env>("addrman-" + std::to_string(num), num);
+    }
+    return *env;
+}
+
+/// Addresses picked from the archive in a pseudo random order, the sequence is the same between runs
+std::vector<std::string> MakeQueries(uint64_t num, uint64_t seed) {
+    std::vector<std::string> addrs(NUM_QUERIES);
+    for (auto& addr : addrs) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        addr = MakeAddress("", (seed >> 33) % num);
+    }
+    return addrs;
+}
+
+void BM_AddrManQuery(benchmark::State& state) {
+    uint64_t num = state.range(0);
+    auto& addr_man = GetEnv(num).addr_man;
+    auto addrs = MakeQueries(num, 0);
+    std::size_t i{0};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(addr_man.Query(addrs[i++ % NUM_QUERIES]));
+    }
+}
+BENCHMARK(BM_AddrManQuery)->Arg(10'000)->Arg(1'000'000)->Arg(10'000'000);
+
+void BM_AddrManQueryMiss(benchmark::State& state) {
+    uint64_t num = state.range(0);
+    auto& addr_man = GetEnv(num).addr_man;
+    std::string addr = MakeAddress("miss", 0);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(addr_man.Query(addr));
+    }
+}
+BENCHMARK(BM_AddrManQueryMiss)->Arg(10'000)->Arg(1'000'000)->Arg(10'000'000);
+
+/// Funds new addresses, the addresses are only reused after `NUM_UPDATES` iterations
+void BM_AddrManUpdate(benchmark::State& state) {
+    uint64_t num = state.range(0);
+    auto& addr_man = GetEnv(num).addr_man;
+    static std::vector<std::string> addrs = []() {
+        std::vector<std::string> addrs(NUM_UPDATES);
+        for (std::size_t i = 0; i < addrs.size(); ++i) {
+            addrs[i] = MakeAddress("new", i);
+        }
+        return addrs;
+    }();
+    std::size_t i{0};
+    for (auto _ : state) {
+        addr_man.Update(addrs[i++ % NUM_UPDATES]);
+    }
+}
+BENCHMARK(BM_AddrManUpdate)->Arg(10'000)->Arg(1'000'000)->Arg(10'000'000);
+
+/// Export to json, every record of the archive and the journal is written
+void BM_AddrManSave(benchmark::State& state) {
+    uint64_t num = state.range(0);
+    auto& env = GetEnv(num);
+    std::string json_path = (env.archive.dir / "export.json").string();
+    for (auto _ : state) {
+        if (!env.addr_man.SaveToFile(json_path)) {
+            state.SkipWithError("cannot save the records");
+            break;
+        }
+    }
+}
+BENCHMARK(BM_AddrManSave)->Arg(10'000)->Arg(1'000'000)->Arg(10'000'000)->Unit(benchmark::kMillisecond);
+
+/// Import from json into an empty db, the records are merged into a new snapshot
+void BM_AddrManLoad(benchmark::State& state) {
+    uint64_t num = state.range(0);
+    auto& env = GetEnv(num);
+    std::string json_path = (env.archive.dir / "import.json").string();
+    if (!env.addr_man.SaveToFile(json_path)) {
+        state.SkipWithError("cannot save the records");
+        return;
+    }
+    std::string db_path = (env.archive.dir / "import-db.bin").string();
+    for (auto _ : state) {
+        state.PauseTiming();
+        fs::remove(db_path);
+        fs::remove(db_path + ".journal");
+        auto addr_man = std::make_unique<FaucetAddrMan>(EXPIRY);
+        addr_man->Open(db_path, std::chrono::milliseconds(1000), std::chrono::hours(24));
+        state.ResumeTiming();
+        if (!addr_man->LoadFromFile(json_path)) {
+            state.SkipWithError("cannot load the records");
+            break;
+        }
+        state.PauseTiming();
+        addr_man.reset();
+        state.ResumeTiming();
+    }
+}
+BENCHMARK(BM_AddrManLoad)->Arg(10'000)->Arg(1'000'000)->Arg(10'000'000)->Unit(benchmark::kMillisecond);
+
+/// Startup, the db file is mapped and the empty journal is replayed
+void BM_AddrManOpen(benchmark::State& state) {
+    uint64_t num = state.range(0);
+    Archive archive("open-" + std::to_string(num), num);
+    for (auto _ : state) {
+        FaucetAddrMan addr_man(EXPIRY);
+        if (!addr_man.Open(archive.db_path, std::chrono::milliseconds(1000), std::chrono::hours(24))) {
+            state.SkipWithError("cannot open the db");
+            break;
+        }
+        benchmark::DoNotOptimize(addr_man.ArchiveSize());
+    }
+}
+BENCHMARK(BM_AddrManOpen)->Arg(10'000)->Arg(1'000'000)->Arg(10'000'000)->Unit(benchmark::kMicrosecond);
+
+/// Lookups of the io threads running concurrently, they share the snapshot and the lock-striped shards
+void BM_AddrManQueryThreads(benchmark::State& state) {
+    uint64_t num = 1'000'000;
+    static auto& addr_man = GetEnv(num).addr_man;
+    auto addrs = MakeQueries(num, state.thread_index());
+    std::size_t i{0};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(addr_man.Query(addrs[i++ % NUM_QUERIES]));
+    }
+}
+BENCHMARK(BM_AddrManQueryThreads)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,49 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "address.h"
+
+namespace {
+
+void ValidateAll(benchmark::State& state, std::vector<std::string> const& addrs, AddressType expect) {
+    std::size_t i{0};
+    for (auto _ : state) {
+        AddressType type = ValidateAddress(addrs[i++ % addrs.size()], AddressParams::Testnet3());
+        if (type != expect) {
+            state.SkipWithError("unexpected address type");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ValidateBech32(benchmark::State& state) {
+    ValidateAll(state,
+            {"tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx", "tb1qqv9pzxqlyckngw6zf9g9whn9d3eh4qvgdtujvv"},
+            AddressType::WitnessV0KeyHash);
+}
+BENCHMARK(BM_ValidateBech32);
+
+void BM_ValidateBech32m(benchmark::State& state) {
+    ValidateAll(state, {"tb1pqqqqp399et2xygdj5xreqhjjvcmzhxw4aywxecjdzew6hylgvsesf3hn0c"},
+            AddressType::WitnessUnknown);
+}
+BENCHMARK(BM_ValidateBech32m);
+
+void BM_ValidateBase58(benchmark::State& state) {
+    ValidateAll(state, {"mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn"}, AddressType::PubKeyHash);
+}
+BENCHMARK(BM_ValidateBase58);
+
+/// Garbage and mainnet addresses, the cost of a rejection
+void BM_ValidateInvalid(benchmark::State& state) {
+    ValidateAll(state,
+            {"hello", "1BvBMSEYstWetqTFn5Au4m4GFg7xJaNVN2", "bc1qw508d6qejxtdg4y5r3zarvary0c5xw7kv8f3t4",
+                    "tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsy"},
+            AddressType::Invalid);
+}
+BENCHMARK(BM_ValidateInvalid);
+
+}  // namespace
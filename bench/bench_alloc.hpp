@@ -0,0 +1,17 @@
+#ifndef BENCH_ALLOC_HPP
+#define BENCH_ALLOC_HPP
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+
+/// The number of heap allocations so far, counted by the `operator new` of bench_main.cpp
+std::size_t AllocCount();
+
+/// Report the heap allocations of each iteration since `begin` as the counter `allocs`
+inline void ReportAllocs(benchmark::State& state, std::size_t begin) {
+    state.counters["allocs"] =
+            benchmark::Counter(static_cast<double>(AllocCount() - begin), benchmark::Counter::kAvgIterations);
+}
+
+#endif
@@ -0,0 +1,155 @@
+#include <benchmark/benchmark.h>
+
+#include <json/reader.h>
+#include <json/value.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "baseline_parser.hpp"
+#include "faucet_service.hpp"
+#include "request_scanner.hpp"
+
+namespace {
+
+std::string const REQUEST_BODY = R"({"address":"tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx"})";
+
+std::string MakeRequest() {
+    std::string req;
+    req += "POST / HTTP/1.1\r\n";
+    req += "Host: faucet.example.org\r\n";
+    req += "User-Agent: curl/7.88.1\r\n";
+    req += "Accept: */*\r\n";
+    req += "Content-Type: application/json\r\n";
+    req += "Content-Length: " + std::to_string(REQUEST_BODY.size()) + "\r\n";
+    req += "\r\n";
+    req += REQUEST_BODY;
+    return req;
+}
+
+/// The whole request arrives in one read, the parser is reused like a keep-alive session does
+void BM_ParserWrite(benchmark::State& state) {
+    std::string req = MakeRequest();
+    SimpleHttpMessageParser parser;
+    for (auto _ : state) {
+        bool done = parser.Write(req.data(), req.size());
+        benchmark::DoNotOptimize(done);
+        parser.Next();
+    }
+    state.SetBytesProcessed(state.iterations() * req.size());
+}
+BENCHMARK(BM_ParserWrite);
+
+/// The request arrives in chunks of `state.range(0)` bytes
+void BM_ParserWriteFragmented(benchmark::State& state) {
+    std::string req = MakeRequest();
+    std::size_t chunk = state.range(0);
+    SimpleHttpMessageParser parser;
+    for (auto _ : state) {
+        bool done{false};
+        for (std::size_t pos = 0; pos < req.size(); pos += chunk) {
+            done = parser.Write(req.data() + pos, std::min(chunk, req.size() - pos));
+        }
+        benchmark::DoNotOptimize(done);
+        parser.Next();
+    }
+    state.SetBytesProcessed(state.iterations() * req.size());
+}
+BENCHMARK(BM_ParserWriteFragmented)->Arg(1)->Arg(16)->Arg(64);
+
+/// The parser before the state machine, a new one for each request like the old session did
+void BM_BaselineParserWrite(benchmark::State& state) {
+    std::string req = MakeRequest();
+    for (auto _ : state) {
+        BaselineHttpMessageParser parser;
+        bool done = parser.Write(req);
+        benchmark::DoNotOptimize(done);
+    }
+    state.SetBytesProcessed(state.iterations() * req.size());
+}
+BENCHMARK(BM_BaselineParserWrite);
+
+void BM_BaselineParserWriteFragmented(benchmark::State& state) {
+    std::string req = MakeRequest();
+    std::size_t chunk = state.range(0);
+    for (auto _ : state) {
+        BaselineHttpMessageParser parser;
+        bool done{false};
+        for (std::size_t pos = 0; pos < req.size(); pos += chunk) {
+            done = parser.Write(req.substr(pos, chunk));
+        }
+        benchmark::DoNotOptimize(done);
+    }
+    state.SetBytesProcessed(state.iterations() * req.size());
+}
+BENCHMARK(BM_BaselineParserWriteFragmented)->Arg(1)->Arg(16)->Arg(64);
+
+/// A txid reply, the body is copied into the response and the buffer sequence is built like `Session` does
+void BM_BuilderWriteContent(benchmark::State& state) {
+    std::string txid(64, 'a');
+    std::vector<asio::const_buffer> bufs;
+    for (auto _ : state) {
+        SimpleHttpMessageBuilder builder;
+        builder.WriteContent(txid, "text/html");
+        SimpleHttpResponse msg = builder.TakeMessage();
+        bufs.clear();
+        msg.AppendBuffers(bufs);
+        benchmark::DoNotOptimize(bufs.data());
+    }
+}
+BENCHMARK(BM_BuilderWriteContent);
+
+/// A fixed text reply, nothing is allocated
+void BM_BuilderWriteStaticContent(benchmark::State& state) {
+    std::vector<asio::const_buffer> bufs;
+    for (auto _ : state) {
+        SimpleHttpMessageBuilder builder;
+        builder.WriteStaticContent("Cannot parse json!", "text/html");
+        SimpleHttpResponse msg = builder.TakeMessage();
+        bufs.clear();
+        msg.AppendBuffers(bufs);
+        benchmark::DoNotOptimize(bufs.data());
+    }
+}
+BENCHMARK(BM_BuilderWriteStaticContent);
+
+/// Extracts the address the same way the request handler does
+void BM_ExtractAddress(benchmark::State& state) {
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string_view body = REQUEST_BODY;
+    for (auto _ : state) {
+        Json::Value root;
+        std::string errs;
+        if (!reader->parse(body.data(), body.data() + body.size(), &root, &errs) || !root.isMember("address")) {
+            state.SkipWithError("cannot extract the address");
+            break;
+        }
+        std::string address = root["address"].asString();
+        benchmark::DoNotOptimize(address.data());
+    }
+}
+BENCHMARK(BM_ExtractAddress);
+
+/// The same body with an escaped address and some noise the scanner has to skip over
+std::string const REQUEST_BODY_ESCAPED =
+        R"({"token": "a\"b\\c", "n": [1, 2.5, -3, {"x": null}], )"
+        R"("address": "tb1qw508d6qejxtdg4y5r3zarvary0c5xw7k\u0078pjzsx"})";
+
+void BM_ScanAddress(benchmark::State& state) {
+    std::string_view body = state.range(0) ? std::string_view(REQUEST_BODY_ESCAPED) : std::string_view(REQUEST_BODY);
+    std::string address;
+    for (auto _ : state) {
+        if (RequestScanner::ScanAddress(body, address) != RequestScanner::Result::Found) {
+            state.SkipWithError("cannot scan the address");
+            break;
+        }
+        benchmark::DoNotOptimize(address.data());
+    }
+}
+BENCHMARK(BM_ScanAddress)->Arg(0)->Arg(1);
+
+}  // namespace
@@ -0,0 +1,113 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <string>
+#include <tuple>
+
+#include "http_client.h"
+#include "rpc_client.h"
+
+namespace {
+
+/**
+ * The benchmarks of this file call a running `btchd-mock-node`, its url is read from `FAUCET_BENCH_NODE`, e.g.
+ * `FAUCET_BENCH_NODE=http://127.0.0.1:18732 faucet-bench --benchmark_filter=BM_Node`. They are skipped without it.
+ */
+char const* GetNodeUrl(benchmark::State& state) {
+    char const* url = std::getenv("FAUCET_BENCH_NODE");
+    if (url == nullptr) {
+        state.SkipWithError("FAUCET_BENCH_NODE is not set");
+    }
+    return url;
+}
+
+std::string MakeCall() {
+    std::string request;
+    RPCClient::WriteRequest(request, 0, "getbalance");
+    return request;
+}
+
+void ReportConnects(benchmark::State& state, long num_connects) {
+    state.counters["calls"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+    state.counters["conns"] = benchmark::Counter(static_cast<double>(num_connects), benchmark::Counter::kIsRate);
+}
+
+/// How `SendMethod` used to call the node: a new curl handle, header list and TCP connection for each call
+void BM_NodeCallNewHandle(benchmark::State& state) {
+    char const* url = GetNodeUrl(state);
+    if (url == nullptr) {
+        return;
+    }
+    std::string request = MakeCall();
+    long num_connects{0};
+    for (auto _ : state) {
+        HTTPClient client(url, "user", "passwd", true);
+        if (!std::get<0>(client.Send(request))) {
+            state.SkipWithError("cannot call the node");
+            return;
+        }
+        benchmark::DoNotOptimize(client.GetReceivedData().data());
+        num_connects += client.GetNumConnects();
+    }
+    ReportConnects(state, num_connects);
+}
+BENCHMARK(BM_NodeCallNewHandle)->UseRealTime();
+
+/// One long-lived handle as it is kept in the pool of `RPCClient`, the connection is opened once
+void BM_NodeCallPooledHandle(benchmark::State& state) {
+    char const* url = GetNodeUrl(state);
+    if (url == nullptr) {
+        return;
+    }
+    std::string request = MakeCall();
+    HTTPClient client(url, "user", "passwd", true);
+    for (auto _ : state) {
+        if (!std::get<0>(client.Send(request))) {
+            state.SkipWithError("cannot call the node");
+            return;
+        }
+        benchmark::DoNotOptimize(client.GetReceivedData().data());
+    }
+    ReportConnects(state, client.GetNumConnects());
+}
+BENCHMARK(BM_NodeCallPooledHandle)->UseRealTime();
+
+/// `state.range(0)` calls in one JSON-RPC array, one round trip for all of them
+void BM_NodeBatch(benchmark::State& state) {
+    char const* url = GetNodeUrl(state);
+    if (url == nullptr) {
+        return;
+    }
+    RPCClient rpc(true, url, "user", "passwd");
+    for (auto _ : state) {
+        RPCClient::Batch batch;
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            batch.Add("getbalance");
+        }
+        rpc.SendBatch(batch);
+        benchmark::DoNotOptimize(batch.GetResult(0));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_NodeBatch)->Arg(1)->Arg(10)->Arg(100)->UseRealTime();
+
+/// The same calls sent one by one, a round trip for each of them
+void BM_NodeSequentialCalls(benchmark::State& state) {
+    char const* url = GetNodeUrl(state);
+    if (url == nullptr) {
+        return;
+    }
+    RPCClient rpc(true, url, "user", "passwd");
+    for (auto _ : state) {
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            RPCClient::Batch batch;
+            batch.Add("getbalance");
+            rpc.SendBatch(batch);
+            benchmark::DoNotOptimize(batch.GetResult(0));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_NodeSequentialCalls)->Arg(1)->Arg(10)->Arg(100)->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,81 @@
+#include <benchmark/benchmark.h>
+
+#include <asio.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "rate_limiter.hpp"
+
+namespace {
+
+/// The flooding clients, consecutive IPv4 addresses from 10.0.0.0 so `/24` aggregation folds 256 of them together
+std::vector<asio::ip::address> MakeSources(std::size_t num) {
+    std::vector<asio::ip::address> sources;
+    sources.reserve(num);
+    for (std::size_t i = 0; i < num; ++i) {
+        sources.emplace_back(asio::ip::address_v4(static_cast<uint32_t>(0x0a000000 + i)));
+    }
+    return sources;
+}
+
+// shared by the threads of one run, so they contend on the shards as the io threads do
+std::unique_ptr<RateLimiter> g_limiter;
+
+std::vector<asio::ip::address> g_sources;
+
+/// A new table for each run, the buckets of the previous run would be warm
+void SetupFlood(benchmark::State const& state, int ipv4_prefix) {
+    RateLimiter::Options opts;
+    opts.rate = 1;
+    opts.burst = 5;
+    opts.ipv4_prefix = ipv4_prefix;
+    g_limiter = std::make_unique<RateLimiter>(opts);
+    g_sources = MakeSources(static_cast<std::size_t>(state.range(0)));
+}
+
+void TeardownFlood(benchmark::State const&) {
+    g_limiter.reset();
+    g_sources.clear();
+}
+
+/**
+ * A flood from `state.range(0)` source IPs, each request takes a token like `Service` does before the body is parsed.
+ * Almost every request is over the limit after the first rounds, which is the path a flood keeps hitting.
+ */
+void BM_RateLimiterFlood(benchmark::State& state) {
+    std::size_t i = static_cast<std::size_t>(state.thread_index()) * 7919;
+    int64_t num_allowed{0};
+    for (auto _ : state) {
+        num_allowed += g_limiter->Consume(g_sources[i++ % g_sources.size()]) ? 1 : 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["allowed"] = benchmark::Counter(static_cast<double>(num_allowed), benchmark::Counter::kAvgThreads);
+    if (state.thread_index() == 0) {
+        state.counters["buckets"] = static_cast<double>(g_limiter->Size());
+    }
+}
+BENCHMARK(BM_RateLimiterFlood)
+        ->Setup([](benchmark::State const& state) { SetupFlood(state, 32); })
+        ->Teardown(TeardownFlood)
+        ->Arg(1)
+        ->Arg(1000)
+        ->Arg(100000)
+        ->Arg(1000000)
+        ->Threads(1)
+        ->Threads(4)
+        ->UseRealTime();
+
+/// The same flood aggregated by `/24`, so 256 sources share a bucket
+BENCHMARK(BM_RateLimiterFlood)
+        ->Name("BM_RateLimiterFloodPrefix24")
+        ->Setup([](benchmark::State const& state) { SetupFlood(state, 24); })
+        ->Teardown(TeardownFlood)
+        ->Arg(100000)
+        ->Arg(1000000)
+        ->Threads(1)
+        ->Threads(4)
+        ->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,88 @@
+#include <benchmark/benchmark.h>
+
+#include <json/reader.h>
+#include <json/value.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench_alloc.hpp"
+#include "rpc_client.h"
+
+namespace {
+
+std::string const ADDRESS = "tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx";
+
+std::string const TXID = "f005294f91b7c4a688ce3d1905b3c2d58118342d4d15eae16fe471212a5f7997";
+
+std::string MakeResponse(int id) {
+    return R"({"result":")" + TXID + R"(","error":null,"id":)" + std::to_string(id) + "}";
+}
+
+std::map<std::string, uint64_t> MakeAmounts(int num) {
+    std::map<std::string, uint64_t> amounts;
+    for (int i = 0; i < num; ++i) {
+        amounts[ADDRESS + std::to_string(i)] = 10 * RPCClient::COIN;
+    }
+    return amounts;
+}
+
+/**
+ * How `SendMethod` used to build and read a call: a json tree serialized by `toStyledString`, a new reader for each
+ * response and a copy of the received data, kept to compare with `BM_RPCCallWriter`
+ */
+void BM_RPCCallJsonValue(benchmark::State& state) {
+    auto amounts = MakeAmounts(static_cast<int>(state.range(0)));
+    std::string response = MakeResponse(0);
+    std::size_t allocs = AllocCount();
+    for (auto _ : state) {
+        Json::Value root;
+        root["jsonrpc"] = "2.0";
+        root["method"] = "sendmany";
+        Json::Value params(Json::arrayValue);
+        params.append(std::string());
+        Json::Value outputs(Json::objectValue);
+        for (auto const& entry : amounts) {
+            outputs[entry.first] = entry.second;
+        }
+        params.append(outputs);
+        root["params"] = params;
+        std::string send_str = root.toStyledString();
+        benchmark::DoNotOptimize(send_str.data());
+
+        Bytes received_data(response.begin(), response.end());
+        char const* psz = reinterpret_cast<char const*>(received_data.data());
+        Json::Value res;
+        Json::CharReaderBuilder builder;
+        std::shared_ptr<Json::CharReader> reader(builder.newCharReader());
+        std::string errs;
+        reader->parse(psz, psz + received_data.size(), &res, &errs);
+        std::string txid = res["result"].asString();
+        benchmark::DoNotOptimize(txid.data());
+    }
+    ReportAllocs(state, allocs);
+}
+BENCHMARK(BM_RPCCallJsonValue)->Arg(1)->Arg(16)->Arg(100);
+
+/// The call written from the fixed fragments into a reused buffer and the response read by the reused reader
+void BM_RPCCallWriter(benchmark::State& state) {
+    auto amounts = MakeAmounts(static_cast<int>(state.range(0)));
+    std::string response = MakeResponse(0);
+    std::string request;
+    std::size_t allocs = AllocCount();
+    for (auto _ : state) {
+        request.clear();
+        RPCClient::WriteRequest(request, 0, "sendmany", std::string(), amounts);
+        benchmark::DoNotOptimize(request.data());
+
+        auto result = RPCClient::ParseResponse(response, 0);
+        std::string txid = result.result.asString();
+        benchmark::DoNotOptimize(txid.data());
+    }
+    ReportAllocs(state, allocs);
+}
+BENCHMARK(BM_RPCCallWriter)->Arg(1)->Arg(16)->Arg(100);
+
+}  // namespace
@@ -0,0 +1,117 @@
+#include <benchmark/benchmark.h>
+
+#include <asio.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "faucet_addr_man.h"
+#include "faucet_service.hpp"
+#include "request_scanner.hpp"
+
+namespace {
+
+int const NUM_CLIENTS = 16;
+
+int const REQUESTS_PER_CLIENT = 200;
+
+std::string MakeAddress(int index) { return "tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjz" + std::to_string(100 + index); }
+
+std::string MakeRequest(std::string const& address) {
+    std::string body = R"({"address":")" + address + R"("})";
+    return "POST / HTTP/1.1\r\n"
+           "Host: 127.0.0.1\r\n"
+           "Content-Type: application/json\r\n"
+           "Content-Length: " +
+           std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+/// Send the requests one by one over a keep-alive connection, returns false when a response is not read
+bool RunClient(tcp::endpoint const& endpoint, std::string const& request, int num) {
+    asio::io_context ioc;
+    tcp::socket s(ioc);
+    asio::error_code ec;
+    s.connect(endpoint, ec);
+    s.set_option(tcp::no_delay(true), ec);
+    std::string buf;
+    for (int i = 0; i < num && !ec; ++i) {
+        asio::write(s, asio::buffer(request), ec);
+        std::size_t header_size = asio::read_until(s, asio::dynamic_buffer(buf), "\r\n\r\n", ec);
+        if (ec) {
+            break;
+        }
+        auto pos = buf.find("Content-Length: ");
+        std::size_t total = header_size + (pos < header_size ? std::atoi(buf.c_str() + pos + 16) : 0);
+        if (buf.size() < total) {
+            asio::read(s, asio::dynamic_buffer(buf), asio::transfer_exactly(total - buf.size()), ec);
+        }
+        buf.erase(0, total);
+    }
+    return !ec;
+}
+
+/**
+ * Requests of the addresses in cooldown served by the service on `state.range(0)` io threads, they are answered
+ * without the node, so the parser, the scanner and the sharded address manager are all that is measured
+ */
+void BM_ServiceCooldownRequests(benchmark::State& state) {
+    int num_threads = static_cast<int>(state.range(0));
+    FaucetAddrMan addr_man(std::chrono::hours(24));
+    std::vector<std::string> requests;
+    for (int i = 0; i < NUM_CLIENTS; ++i) {
+        addr_man.Update(MakeAddress(i));
+        requests.push_back(MakeRequest(MakeAddress(i)));
+    }
+    ServiceOptions opts;
+    opts.max_requests_per_conn = std::numeric_limits<int>::max();
+    asio::io_context ioc;
+    Service service(
+            ioc, tcp::endpoint(asio::ip::address_v4::loopback(), 0),
+            [&addr_man](std::shared_ptr<Session> const& psession, SimpleHttpMessageParser const& parser) {
+                std::string address;
+                SimpleHttpMessageBuilder msg_builder(psession->KeepAlive());
+                if (RequestScanner::ScanAddress(parser.ReadBody(), address) == RequestScanner::Result::Found &&
+                        addr_man.Query(address) != 0) {
+                    msg_builder.WriteContent("Address " + address + " already funded", "text/html");
+                } else {
+                    msg_builder.WriteStaticContent("Unexpected request.", "text/html", 400);
+                }
+                psession->Write(msg_builder.TakeMessage());
+            },
+            opts);
+    auto work = asio::make_work_guard(ioc);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back([&ioc]() { ioc.run(); });
+    }
+    tcp::endpoint endpoint = service.GetLocalEndpoint();
+    for (auto _ : state) {
+        std::vector<std::thread> clients;
+        std::vector<char> succ(NUM_CLIENTS, 0);
+        for (int i = 0; i < NUM_CLIENTS; ++i) {
+            clients.emplace_back([&, i]() { succ[i] = RunClient(endpoint, requests[i], REQUESTS_PER_CLIENT); });
+        }
+        for (auto& t : clients) {
+            t.join();
+        }
+        if (std::find(std::begin(succ), std::end(succ), 0) != std::end(succ)) {
+            state.SkipWithError("a client cannot read its responses");
+            break;
+        }
+    }
+    work.reset();
+    ioc.stop();
+    for (auto& t : threads) {
+        t.join();
+    }
+    state.SetItemsProcessed(state.iterations() * NUM_CLIENTS * REQUESTS_PER_CLIENT);
+}
+BENCHMARK(BM_ServiceCooldownRequests)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+}  // namespace
@@ -0,0 +1,42 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <string>
+
+#include "utils.hpp"
+
+namespace {
+
+void BM_BytesToHex(benchmark::State& state) {
+    Bytes bytes(state.range(0));
+    for (std::size_t i = 0; i < bytes.size(); ++i) {
+        bytes[i] = static_cast<uint8_t>(i * 131);
+    }
+    for (auto _ : state) {
+        std::string hex = BytesToHex(bytes);
+        benchmark::DoNotOptimize(hex.data());
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_BytesToHex)->Arg(32)->Arg(256);
+
+void BM_ToLowerCase(benchmark::State& state) {
+    std::string str = "Content-Type: Application/JSON";
+    for (auto _ : state) {
+        std::string lower = ToLowerCase(str);
+        benchmark::DoNotOptimize(lower.data());
+    }
+}
+BENCHMARK(BM_ToLowerCase);
+
+void BM_ExpandEnvPath(benchmark::State& state) {
+    setenv("FAUCET_BENCH_HOME", "/home/faucet", 1);
+    std::string path = "$FAUCET_BENCH_HOME/.btchd/testnet3/.cookie";
+    for (auto _ : state) {
+        std::string expanded = ExpandEnvPath(path);
+        benchmark::DoNotOptimize(expanded.data());
+    }
+}
+BENCHMARK(BM_ExpandEnvPath);
+
+}  // namespace
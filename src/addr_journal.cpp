@@ -0,0 +1,40 @@
+#include "addr_journal.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <plog/Log.h>
+
+std::size_t AddrJournal::Replay(std::string const& path, ReplayCallback const& callback) {
+    return RecordJournal::Replay(path, sizeof(Record), MAGIC, [&callback](void const* p) {
+        Record record;
+        memcpy(&record, p, sizeof(record));
+        callback(std::string(record.addr, std::min<std::size_t>(record.addr_len, ADDR_MAX_LEN)), record.time);
+    });
+}
+
+bool AddrJournal::Open(std::string const& path) {
+    return m_file.Open(path);
+}
+
+bool AddrJournal::Append(std::string const& addr, int64_t time) {
+    if (addr.size() > ADDR_MAX_LEN) {
+        PLOG_ERROR << "address is too long to be journaled: " << addr;
+        return false;
+    }
+    Record record;
+    memset(&record, 0, sizeof(record));
+    record.time = time;
+    record.addr_len = static_cast<uint8_t>(addr.size());
+    memcpy(record.addr, addr.data(), addr.size());
+    m_file.Append(&record);
+    return true;
+}
+
+bool AddrJournal::Sync() {
+    return m_file.Sync();
+}
+
+bool AddrJournal::Rotate(std::string const& rotated_path) {
+    return m_file.Rotate(rotated_path);
+}
@@ -0,0 +1,46 @@
+#ifndef FAUCET_ADDR_JOURNAL_H
+#define FAUCET_ADDR_JOURNAL_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "record_journal.h"
+
+/// The `RecordJournal` of the fund records, a record torn by a crash is cut off on `Open`
+class AddrJournal {
+public:
+    static const std::size_t ADDR_MAX_LEN = 111;
+
+    using ReplayCallback = std::function<void(std::string const& addr, int64_t time)>;
+
+    /// Read all valid records from the journal file, returns the number of them
+    static std::size_t Replay(std::string const& path, ReplayCallback const& callback);
+
+    /// Open the journal file for appending, the torn record at the tail will be truncated
+    bool Open(std::string const& path);
+
+    /// Buffer the record, it reaches the disk on next `Sync`
+    bool Append(std::string const& addr, int64_t time);
+
+    bool Sync();
+
+    /// Sync and move the journal to `rotated_path`, following records go to a new empty journal
+    bool Rotate(std::string const& rotated_path);
+
+private:
+    static const uint32_t MAGIC = 0x4a444842;  // "BHDJ"
+
+    struct Record {
+        RecordJournal::Header header;
+        int64_t time;
+        uint8_t addr_len;
+        char addr[ADDR_MAX_LEN];
+    };
+    static_assert(sizeof(Record) == 128, "journal record must be 128 bytes");
+
+private:
+    RecordJournal m_file{sizeof(Record), MAGIC};
+};
+
+#endif
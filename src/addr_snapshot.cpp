@@ -0,0 +1,151 @@
+#include "addr_snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <plog/Log.h>
+
+#include "record_journal.h"
+
+namespace {
+
+char const SNAPSHOT_MAGIC[8] = {'B', 'H', 'D', 'F', 'D', 'B', '\0', '\0'};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t count;
+    uint64_t reserved;
+};
+static_assert(sizeof(Header) == 32, "snapshot header must be 32 bytes");
+
+int CompareKey(char const* key, std::string_view addr) {
+    int res = memcmp(key, addr.data(), addr.size());
+    if (res != 0) {
+        return res;
+    }
+    // the key is longer than the address when it isn't padded at this position
+    return addr.size() < AddrSnapshot::ADDR_KEY_LEN && key[addr.size()] != '\0' ? 1 : 0;
+}
+
+}  // namespace
+
+AddrSnapshot::Writer::Writer(std::string path) : m_path(std::move(path)), m_tmp_path(m_path + ".tmp") {
+    m_file = std::fopen(m_tmp_path.c_str(), "wb");
+    if (m_file == nullptr) {
+        PLOG_ERROR << "cannot open file to write: " << m_tmp_path << ", " << strerror(errno);
+        m_failed = true;
+        return;
+    }
+    // the header is written again with the real count on commit
+    Header header{};
+    if (std::fwrite(&header, sizeof(header), 1, m_file) != 1) {
+        m_failed = true;
+    }
+}
+
+AddrSnapshot::Writer::~Writer() {
+    if (m_file != nullptr) {
+        std::fclose(m_file);
+        std::remove(m_tmp_path.c_str());
+    }
+}
+
+bool AddrSnapshot::Writer::Add(std::string_view addr, int64_t time) {
+    if (m_failed) {
+        return false;
+    }
+    if (addr.empty() || addr.size() > ADDR_KEY_LEN) {
+        PLOG_ERROR << "address cannot be stored to snapshot: " << addr;
+        return false;
+    }
+    Entry entry;
+    memset(&entry, 0, sizeof(entry));
+    memcpy(entry.addr, addr.data(), addr.size());
+    entry.time = time;
+    if (std::fwrite(&entry, sizeof(entry), 1, m_file) != 1) {
+        m_failed = true;
+        return false;
+    }
+    ++m_count;
+    return true;
+}
+
+bool AddrSnapshot::Writer::Commit() {
+    if (m_failed) {
+        return false;
+    }
+    Header header{};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.entry_size = sizeof(Entry);
+    header.count = m_count;
+    bool succ = std::fseek(m_file, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, m_file) == 1 &&
+                std::fflush(m_file) == 0 && fsync(fileno(m_file)) == 0;
+    std::fclose(m_file);
+    m_file = nullptr;
+    if (!succ || rename(m_tmp_path.c_str(), m_path.c_str()) != 0) {
+        PLOG_ERROR << "cannot write snapshot: " << m_path << ", " << strerror(errno);
+        std::remove(m_tmp_path.c_str());
+        return false;
+    }
+    // the rename is only durable once the directory is synced
+    if (!RecordJournal::SyncParentDir(m_path)) {
+        PLOG_ERROR << "cannot sync the directory of snapshot: " << m_path << ", " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<AddrSnapshot const> AddrSnapshot::Open(std::string const& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Header)) {
+        close(fd);
+        return nullptr;
+    }
+    std::size_t size = st.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        PLOG_ERROR << "cannot map snapshot: " << path << ", " << strerror(errno);
+        return nullptr;
+    }
+    auto header = static_cast<Header const*>(data);
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header->version != VERSION ||
+            header->entry_size != sizeof(Entry) || header->count > (size - sizeof(Header)) / sizeof(Entry)) {
+        munmap(data, size);
+        return nullptr;
+    }
+    madvise(data, size, MADV_RANDOM);
+    auto entries = reinterpret_cast<Entry const*>(static_cast<char const*>(data) + sizeof(Header));
+    return std::shared_ptr<AddrSnapshot const>(new AddrSnapshot(data, size, entries, header->count));
+}
+
+AddrSnapshot::~AddrSnapshot() { munmap(m_data, m_size); }
+
+int64_t AddrSnapshot::Find(std::string_view addr) const {
+    if (addr.empty() || addr.size() > ADDR_KEY_LEN) {
+        return 0;
+    }
+    auto i = std::lower_bound(begin(), end(), addr,
+            [](Entry const& entry, std::string_view addr) { return CompareKey(entry.addr, addr) < 0; });
+    if (i == end() || CompareKey(i->addr, addr) != 0) {
+        return 0;
+    }
+    return i->time;
+}
+
+std::string_view AddrSnapshot::GetAddress(Entry const& entry) {
+    return std::string_view(entry.addr, strnlen(entry.addr, ADDR_KEY_LEN));
+}
@@ -0,0 +1,82 @@
+#ifndef FAUCET_ADDR_SNAPSHOT_H
+#define FAUCET_ADDR_SNAPSHOT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * Versioned binary db file which is mapped into memory. It holds fixed-width entries sorted by address, so the file
+ * is usable right after `mmap` and a lookup is a binary search without any allocation.
+ *
+ * Layout: 32-byte header (magic, version, entry size, number of entries) followed by the entries.
+ */
+class AddrSnapshot {
+public:
+    static const std::size_t ADDR_KEY_LEN = 120;
+
+    static const uint32_t VERSION = 1;
+
+    struct Entry {
+        char addr[ADDR_KEY_LEN];  // padded with '\0'
+        int64_t time;
+    };
+    static_assert(sizeof(Entry) == 128, "snapshot entry must be 128 bytes");
+
+    /// Writes the entries in ascending order of address and replaces the file atomically on `Commit`
+    class Writer {
+    public:
+        explicit Writer(std::string path);
+
+        ~Writer();
+
+        Writer(Writer const&) = delete;
+
+        Writer& operator=(Writer const&) = delete;
+
+        bool Add(std::string_view addr, int64_t time);
+
+        bool Commit();
+
+    private:
+        std::string m_path;
+        std::string m_tmp_path;
+        std::FILE* m_file{nullptr};
+        uint64_t m_count{0};
+        bool m_failed{false};
+    };
+
+    /// Map the file, nullptr is returned when the file doesn't exist or it isn't a snapshot
+    static std::shared_ptr<AddrSnapshot const> Open(std::string const& path);
+
+    ~AddrSnapshot();
+
+    AddrSnapshot(AddrSnapshot const&) = delete;
+
+    AddrSnapshot& operator=(AddrSnapshot const&) = delete;
+
+    /// The fund time of the address, 0 if it cannot be found
+    int64_t Find(std::string_view addr) const;
+
+    std::size_t Size() const { return m_count; }
+
+    Entry const* begin() const { return m_entries; }
+
+    Entry const* end() const { return m_entries + m_count; }
+
+    static std::string_view GetAddress(Entry const& entry);
+
+private:
+    AddrSnapshot(void* data, std::size_t size, Entry const* entries, std::size_t count)
+            : m_data(data), m_size(size), m_entries(entries), m_count(count) {}
+
+private:
+    void* m_data;
+    std::size_t m_size;
+    Entry const* m_entries;
+    std::size_t m_count;
+};
+
+#endif
@@ -0,0 +1,275 @@
+#include "address.h"
+
+#include <array>
+#include <cstring>
+
+#include "sha256.h"
+
+namespace {
+
+// Base58Check addresses are a version byte, a 20-byte hash and a 4-byte checksum
+std::size_t const BASE58_PAYLOAD_SIZE = 25;
+
+// the longest Base58 string which can hold 25 bytes
+std::size_t const MAX_BASE58_SIZE = 35;
+
+std::size_t const MAX_BECH32_SIZE = 90;
+
+char const BASE58_CHARS[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+char const BECH32_CHARS[] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+
+uint32_t const BECH32_CONST = 1;
+
+uint32_t const BECH32M_CONST = 0x2bc830a3;
+
+constexpr std::array<int8_t, 128> MakeReverseTable(char const* chars) {
+    std::array<int8_t, 128> table{};
+    for (auto& v : table) {
+        v = -1;
+    }
+    for (int i = 0; chars[i] != '\0'; ++i) {
+        table[static_cast<uint8_t>(chars[i])] = static_cast<int8_t>(i);
+    }
+    return table;
+}
+
+constexpr std::array<int8_t, 128> BASE58_VALUES = MakeReverseTable(BASE58_CHARS);
+
+constexpr std::array<int8_t, 128> BECH32_VALUES = MakeReverseTable(BECH32_CHARS);
+
+/// Decode into a fixed-size big-endian buffer, false when the value doesn't fit exactly
+bool DecodeBase58(std::string_view str, std::array<uint8_t, BASE58_PAYLOAD_SIZE>& out) {
+    if (str.empty() || str.size() > MAX_BASE58_SIZE) {
+        return false;
+    }
+    std::size_t leading_zeros{0};
+    while (leading_zeros < str.size() && str[leading_zeros] == '1') {
+        ++leading_zeros;
+    }
+    out.fill(0);
+    for (char ch : str) {
+        auto c = static_cast<uint8_t>(ch);
+        if (c >= 128 || BASE58_VALUES[c] < 0) {
+            return false;
+        }
+        uint32_t carry = BASE58_VALUES[c];
+        for (auto i = out.rbegin(); i != out.rend(); ++i) {
+            carry += static_cast<uint32_t>(*i) * 58;
+            *i = static_cast<uint8_t>(carry);
+            carry >>= 8;
+        }
+        if (carry != 0) {
+            return false;
+        }
+    }
+    // the leading '1's are the leading zero bytes, the rest of the value must not start with another zero
+    std::size_t zeros{0};
+    while (zeros < out.size() && out[zeros] == 0) {
+        ++zeros;
+    }
+    return zeros == leading_zeros;
+}
+
+uint32_t Bech32Polymod(uint32_t chk, uint8_t value) {
+    uint8_t top = chk >> 25;
+    chk = ((chk & 0x1ffffff) << 5) ^ value;
+    if (top & 1) chk ^= 0x3b6a57b2;
+    if (top & 2) chk ^= 0x26508e6d;
+    if (top & 4) chk ^= 0x1ea119fa;
+    if (top & 8) chk ^= 0x3d4233dd;
+    if (top & 16) chk ^= 0x2a1462b3;
+    return chk;
+}
+
+uint32_t Bech32HrpChecksum(std::string_view hrp) {
+    uint32_t chk = 1;
+    for (char ch : hrp) {
+        chk = Bech32Polymod(chk, static_cast<uint8_t>(ch) >> 5);
+    }
+    chk = Bech32Polymod(chk, 0);
+    for (char ch : hrp) {
+        chk = Bech32Polymod(chk, static_cast<uint8_t>(ch) & 31);
+    }
+    return chk;
+}
+
+AddressType ValidateBase58Address(std::string_view address, AddressParams const& params) {
+    std::array<uint8_t, BASE58_PAYLOAD_SIZE> payload;
+    if (!DecodeBase58(address, payload)) {
+        return AddressType::Invalid;
+    }
+    auto hash = SHA256::Hash256(payload.data(), BASE58_PAYLOAD_SIZE - 4);
+    if (memcmp(hash.data(), payload.data() + BASE58_PAYLOAD_SIZE - 4, 4) != 0) {
+        return AddressType::Invalid;
+    }
+    if (payload[0] == params.pubkey_prefix) {
+        return AddressType::PubKeyHash;
+    }
+    if (payload[0] == params.script_prefix) {
+        return AddressType::ScriptHash;
+    }
+    return AddressType::Invalid;
+}
+
+AddressType ValidateSegwitAddress(std::string_view address, AddressParams const& params) {
+    if (address.size() > MAX_BECH32_SIZE) {
+        return AddressType::Invalid;
+    }
+    auto sep = address.rfind('1');
+    // the data part holds at least the witness version and the 6 characters of the checksum
+    if (sep != params.hrp.size() || address.size() < sep + 8) {
+        return AddressType::Invalid;
+    }
+    bool has_lower{false}, has_upper{false};
+    for (std::size_t i = 0; i < sep; ++i) {
+        char ch = address[i];
+        has_lower |= ch >= 'a' && ch <= 'z';
+        has_upper |= ch >= 'A' && ch <= 'Z';
+        char lower = (ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch - 'A' + 'a') : ch;
+        if (lower != params.hrp[i]) {
+            return AddressType::Invalid;
+        }
+    }
+    uint32_t chk = Bech32HrpChecksum(params.hrp);
+    // 5-bit groups of the program are converted into bytes on the fly
+    int version{-1};
+    std::size_t program_size{0};
+    uint32_t acc{0};
+    int bits{0};
+    std::size_t data_end = address.size() - 6;
+    for (std::size_t i = sep + 1; i < address.size(); ++i) {
+        char ch = address[i];
+        has_lower |= ch >= 'a' && ch <= 'z';
+        has_upper |= ch >= 'A' && ch <= 'Z';
+        auto c = static_cast<uint8_t>(ch >= 'A' && ch <= 'Z' ? ch - 'A' + 'a' : ch);
+        if (c >= 128 || BECH32_VALUES[c] < 0) {
+            return AddressType::Invalid;
+        }
+        uint8_t value = BECH32_VALUES[c];
+        chk = Bech32Polymod(chk, value);
+        if (i >= data_end) {
+            continue;
+        }
+        if (version < 0) {
+            version = value;
+            continue;
+        }
+        acc = (acc << 5) | value;
+        bits += 5;
+        if (bits >= 8) {
+            bits -= 8;
+            ++program_size;
+        }
+    }
+    // the padding must be less than a group and all zeros
+    if ((has_lower && has_upper) || bits >= 5 || (acc & ((1u << bits) - 1)) != 0) {
+        return AddressType::Invalid;
+    }
+    if (version > 16 || program_size < 2 || program_size > 40) {
+        return AddressType::Invalid;
+    }
+    if (version == 0) {
+        if (chk != BECH32_CONST) {
+            return AddressType::Invalid;
+        }
+        if (program_size == 20) {
+            return AddressType::WitnessV0KeyHash;
+        }
+        if (program_size == 32) {
+            return AddressType::WitnessV0ScriptHash;
+        }
+        return AddressType::Invalid;
+    }
+    return chk == BECH32M_CONST ? AddressType::WitnessUnknown : AddressType::Invalid;
+}
+
+}  // namespace
+
+AddressType ValidateAddress(std::string_view address, AddressParams const& params) {
+    // a segwit address always contains the separator '1' right after its hrp, Base58 has no '1' there
+    if (address.size() > params.hrp.size() && address[params.hrp.size()] == '1') {
+        AddressType type = ValidateSegwitAddress(address, params);
+        if (type != AddressType::Invalid) {
+            return type;
+        }
+    }
+    return ValidateBase58Address(address, params);
+}
+
+void NormalizeAddress(std::string& address, AddressType type) {
+    if (type != AddressType::WitnessV0KeyHash && type != AddressType::WitnessV0ScriptHash &&
+            type != AddressType::WitnessUnknown) {
+        return;
+    }
+    for (char& ch : address) {
+        if (ch >= 'A' && ch <= 'Z') {
+            ch = static_cast<char>(ch - 'A' + 'a');
+        }
+    }
+}
+
+std::string EncodeSegwitAddress(std::string_view hrp, int version, Bytes const& program) {
+    std::string data;
+    data.push_back(static_cast<char>(version));
+    uint32_t acc{0};
+    int bits{0};
+    for (uint8_t byte : program) {
+        acc = (acc << 8) | byte;
+        bits += 8;
+        while (bits >= 5) {
+            bits -= 5;
+            data.push_back(static_cast<char>((acc >> bits) & 31));
+        }
+    }
+    if (bits > 0) {
+        data.push_back(static_cast<char>((acc << (5 - bits)) & 31));
+    }
+    uint32_t chk = Bech32HrpChecksum(hrp);
+    for (char value : data) {
+        chk = Bech32Polymod(chk, static_cast<uint8_t>(value));
+    }
+    for (int i = 0; i < 6; ++i) {
+        chk = Bech32Polymod(chk, 0);
+    }
+    chk ^= version == 0 ? BECH32_CONST : BECH32M_CONST;
+    std::string res(hrp);
+    res.push_back('1');
+    for (char value : data) {
+        res.push_back(BECH32_CHARS[static_cast<uint8_t>(value)]);
+    }
+    for (int i = 0; i < 6; ++i) {
+        res.push_back(BECH32_CHARS[(chk >> ((5 - i) * 5)) & 31]);
+    }
+    return res;
+}
+
+std::string EncodeBase58Check(uint8_t version, Bytes const& payload) {
+    Bytes data;
+    data.reserve(payload.size() + 5);
+    data.push_back(version);
+    data.insert(std::end(data), std::begin(payload), std::end(payload));
+    auto hash = SHA256::Hash256(data.data(), data.size());
+    data.insert(std::end(data), std::begin(hash), std::begin(hash) + 4);
+    // repeated division of the big-endian number by 58
+    std::string res;
+    Bytes num = data;
+    std::size_t start{0};
+    while (start < num.size() && num[start] == 0) {
+        ++start;
+    }
+    for (std::size_t i = start; i < num.size();) {
+        uint32_t rem{0};
+        for (std::size_t j = i; j < num.size(); ++j) {
+            uint32_t cur = (rem << 8) | num[j];
+            num[j] = static_cast<uint8_t>(cur / 58);
+            rem = cur % 58;
+        }
+        res.push_back(BASE58_CHARS[rem]);
+        while (i < num.size() && num[i] == 0) {
+            ++i;
+        }
+    }
+    res.append(start, '1');
+    return std::string(res.rbegin(), res.rend());
+}
@@ -0,0 +1,45 @@
+#ifndef FAUCET_ADDRESS_H
+#define FAUCET_ADDRESS_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "types.hpp"
+
+enum class AddressType { Invalid, PubKeyHash, ScriptHash, WitnessV0KeyHash, WitnessV0ScriptHash, WitnessUnknown };
+
+/// The address prefixes of a network
+struct AddressParams {
+    uint8_t pubkey_prefix;
+    uint8_t script_prefix;
+    std::string_view hrp;
+
+    /// BitcoinHD testnet3 keeps the prefixes of bitcoin testnet
+    static AddressParams const& Testnet3() {
+        static AddressParams const params{111, 196, "tb"};
+        return params;
+    }
+};
+
+/**
+ * Decode the address as Base58Check (P2PKH and P2SH) or as a segwit address (Bech32 for version 0 and Bech32m for the
+ * later versions), the checksum and the prefix of the network are verified. Nothing is allocated.
+ *
+ * @return the type of the address, `AddressType::Invalid` when it cannot be paid on the network
+ */
+AddressType ValidateAddress(std::string_view address, AddressParams const& params);
+
+/**
+ * Turn a valid address into the form it is recorded and paid with. Segwit addresses are case-insensitive and lower-cased
+ * here, so `TB1Q…` and `tb1q…` share one cooldown, Base58 addresses are case-sensitive and kept as they are.
+ */
+void NormalizeAddress(std::string& address, AddressType type);
+
+/// Encode a segwit program, Bech32 for version 0 and Bech32m for the later versions
+std::string EncodeSegwitAddress(std::string_view hrp, int version, Bytes const& program);
+
+/// Encode the payload with a leading version byte as Base58Check
+std::string EncodeBase58Check(uint8_t version, Bytes const& payload);
+
+#endif
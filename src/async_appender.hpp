@@ -0,0 +1,138 @@
+#ifndef FAUCET_ASYNC_APPENDER_HPP
+#define FAUCET_ASYNC_APPENDER_HPP
+
+#include <plog/Log.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metrics.hpp"
+
+/// What an `AsyncAppender` does with a line when its queue is full
+enum class LogFullPolicy { Drop, Block };
+
+/**
+ * A plog appender which only formats the record on the logging thread and queues the line, a background thread
+ * writes the queued lines to stdout in batches. The queue is a bounded lock-free ring, when it is full the line is
+ * either dropped and counted or the logging thread waits for room, depending on the policy.
+ */
+template <typename Formatter>
+class AsyncAppender : public plog::IAppender {
+public:
+    AsyncAppender(std::size_t capacity, LogFullPolicy policy)
+        : m_slots(RoundUpPow2(capacity)), m_mask(m_slots.size() - 1), m_policy(policy) {
+        for (std::size_t i = 0; i < m_slots.size(); ++i) {
+            m_slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+        m_thread = std::thread([this]() { Run(); });
+    }
+
+    /// The queued lines are written before the appender is gone
+    ~AsyncAppender() override {
+        m_stop.store(true, std::memory_order_release);
+        m_thread.join();
+    }
+
+    AsyncAppender(AsyncAppender const&) = delete;
+
+    AsyncAppender& operator=(AsyncAppender const&) = delete;
+
+    void write(plog::Record const& record) override {
+        std::string line = Formatter::format(record);
+        while (!TryPush(line)) {
+            if (m_policy == LogFullPolicy::Drop) {
+                GetMetrics().Inc(Metrics::Counter::LogLinesDropped);
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    static constexpr std::chrono::milliseconds IDLE_WAIT{5};
+
+    static std::size_t const MAX_BATCH_SIZE = 64 * 1024;
+
+    /// The sequence tells the state of the slot: `pos` is free for the producer of `pos`, `pos + 1` holds its line
+    struct alignas(64) Slot {
+        std::atomic<std::size_t> seq;
+        std::string line;
+    };
+
+    static std::size_t RoundUpPow2(std::size_t n) {
+        std::size_t size = 2;
+        while (size < n) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    bool TryPush(std::string& line) {
+        std::size_t pos = m_tail.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = m_slots[pos & m_mask];
+            std::size_t seq = slot.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.line = std::move(line);
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // the consumer has not taken the line of the previous round yet
+                return false;
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// Only called by the background thread
+    bool TryPop(std::string& out_line) {
+        Slot& slot = m_slots[m_head & m_mask];
+        if (slot.seq.load(std::memory_order_acquire) != m_head + 1) {
+            return false;
+        }
+        out_line = std::move(slot.line);
+        slot.seq.store(m_head + m_slots.size(), std::memory_order_release);
+        ++m_head;
+        return true;
+    }
+
+    void Run() {
+        std::string batch;
+        std::string line;
+        while (true) {
+            bool stop = m_stop.load(std::memory_order_acquire);
+            while (batch.size() < MAX_BATCH_SIZE && TryPop(line)) {
+                batch += line;
+            }
+            if (!batch.empty()) {
+                fwrite(batch.data(), 1, batch.size(), stdout);
+                fflush(stdout);
+                batch.clear();
+                continue;
+            }
+            if (stop) {
+                break;
+            }
+            std::this_thread::sleep_for(IDLE_WAIT);
+        }
+    }
+
+    std::vector<Slot> m_slots;
+    std::size_t m_mask;
+    LogFullPolicy m_policy;
+    alignas(64) std::atomic<std::size_t> m_tail{0};
+    alignas(64) std::size_t m_head{0};
+    std::atomic<bool> m_stop{false};
+    std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef FAUCET_BACKEND_PROBER_HPP
+#define FAUCET_BACKEND_PROBER_HPP
+
+#include <asio.hpp>
+
+#include <chrono>
+
+#include "rpc_client.h"
+
+/// Runs `RPCClient::ProbeBackends` on the RPC pool every `interval`, the first probe is run right away
+class BackendProber {
+public:
+    BackendProber(asio::io_context& ioc, asio::thread_pool& rpc_pool, RPCClient& rpc, std::chrono::seconds interval)
+        : m_timer(asio::make_strand(ioc)), m_rpc_pool(rpc_pool), m_rpc(rpc), m_interval(interval) {}
+
+    void Start() { ScheduleProbe(std::chrono::steady_clock::duration::zero()); }
+
+private:
+    void ScheduleProbe(std::chrono::steady_clock::duration delay) {
+        m_timer.expires_after(delay);
+        m_timer.async_wait([this](std::error_code const& ec) {
+            if (ec == asio::error::operation_aborted) {
+                return;
+            }
+            asio::post(m_rpc_pool, [this]() {
+                m_rpc.ProbeBackends();
+                asio::post(m_timer.get_executor(), [this]() { ScheduleProbe(m_interval); });
+            });
+        });
+    }
+
+    asio::steady_timer m_timer;
+    asio::thread_pool& m_rpc_pool;
+    RPCClient& m_rpc;
+    std::chrono::seconds m_interval;
+};
+
+#endif
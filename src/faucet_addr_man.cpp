@@ -0,0 +1,339 @@
+#include "faucet_addr_man.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <plog/Log.h>
+
+#include <json/reader.h>
+#include <json/value.h>
+
+#include "metrics.hpp"
+#include "record_journal.h"
+
+namespace {
+
+/// Write the content to a temporary file and rename it over `path`, readers never see a partially written file
+bool WriteFileAtomically(std::string const& path, std::string const& content) {
+    std::string tmp_path = path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        PLOG_ERROR << "cannot open file to write: " << tmp_path << ", " << strerror(errno);
+        return false;
+    }
+    char const* p = content.data();
+    std::size_t remaining = content.size();
+    while (remaining > 0) {
+        ssize_t n = write(fd, p, remaining);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            PLOG_ERROR << "cannot write file: " << tmp_path << ", " << strerror(errno);
+            close(fd);
+            return false;
+        }
+        p += n;
+        remaining -= n;
+    }
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    if (!synced) {
+        PLOG_ERROR << "cannot sync file: " << tmp_path << ", " << strerror(errno);
+        return false;
+    }
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+        PLOG_ERROR << "cannot replace file: " << path << ", " << strerror(errno);
+        return false;
+    }
+    if (!RecordJournal::SyncParentDir(path)) {
+        PLOG_ERROR << "cannot sync the directory of file: " << path << ", " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+FaucetAddrMan::~FaucetAddrMan() {
+    if (m_bg_thread.joinable()) {
+        {
+            std::lock_guard lock(m_bg_mtx);
+            m_bg_stop = true;
+        }
+        m_bg_cv.notify_all();
+        m_bg_thread.join();
+    }
+}
+
+bool FaucetAddrMan::Open(std::string const& db_path, std::chrono::milliseconds sync_interval,
+        std::chrono::seconds compact_interval) {
+    m_db_path = db_path;
+    m_snapshot = AddrSnapshot::Open(m_db_path);
+    if (m_snapshot) {
+        PLOG_DEBUG << "mapped " << m_snapshot->Size() << " record(s) from db file";
+    } else if (access(m_db_path.c_str(), F_OK) == 0) {
+        // the db file written by the older version is json, it is converted to a snapshot
+        PLOG_INFO << "db file isn't a snapshot, import it as json: " << m_db_path;
+        if (!LoadFromFile(m_db_path)) {
+            return false;
+        }
+    }
+    // the rotated journal only exists when the last compaction didn't finish
+    auto replay = [this](std::string const& addr, int64_t time) { Set(addr, time); };
+    std::size_t num_replayed = AddrJournal::Replay(GetRotatedJournalPath(), replay);
+    num_replayed += AddrJournal::Replay(GetJournalPath(), replay);
+    PLOG_DEBUG << "replayed " << num_replayed << " record(s) from journal, " << Size()
+               << " record(s) are in cooldown";
+    if (!m_journal.Open(GetJournalPath())) {
+        return false;
+    }
+    m_journal_opened = true;
+    sync_interval = std::max(sync_interval, std::chrono::milliseconds(1));
+    m_bg_thread = std::thread([this, sync_interval, compact_interval]() {
+        BackgroundLoop(sync_interval, compact_interval);
+    });
+    return true;
+}
+
+bool FaucetAddrMan::Compact() {
+    StageTimer timer(Metrics::Stage::DbCompact);
+    std::lock_guard save_lock(m_save_mtx);
+    std::string rotated_path = GetRotatedJournalPath();
+    // a rotated journal left by a failed compaction is merged first, the current one waits for the next compaction
+    if (access(rotated_path.c_str(), F_OK) != 0 && !m_journal.Rotate(rotated_path)) {
+        return false;
+    }
+    std::vector<Record> records;
+    AddrJournal::Replay(rotated_path, [&records](std::string const& addr, int64_t time) {
+        records.emplace_back(addr, time);
+    });
+    if (!MergeIntoArchive(std::move(records))) {
+        return false;
+    }
+    if (remove(rotated_path.c_str()) != 0) {
+        PLOG_ERROR << "cannot remove the rotated journal: " << rotated_path << ", " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool FaucetAddrMan::SaveToFile(std::string const& path) {
+    std::lock_guard save_lock(m_save_mtx);
+    m_journal.Sync();
+    std::map<std::string, int64_t> records;
+    auto snapshot = GetSnapshot();
+    if (snapshot) {
+        for (auto const& entry : *snapshot) {
+            records.emplace(AddrSnapshot::GetAddress(entry), entry.time);
+        }
+    }
+    auto replay = [&records](std::string const& addr, int64_t time) {
+        int64_t& record = records[addr];
+        record = std::max(record, time);
+    };
+    AddrJournal::Replay(GetRotatedJournalPath(), replay);
+    AddrJournal::Replay(GetJournalPath(), replay);
+    Json::Value root(Json::arrayValue);
+    for (auto i = std::begin(records); i != std::end(records); ++i) {
+        Json::Value r;
+        r["address"] = i->first;
+        r["time"] = static_cast<Json::Int64>(i->second);
+        root.append(r);
+    }
+    return WriteFileAtomically(path, root.toStyledString());
+}
+
+bool FaucetAddrMan::LoadFromFile(std::string const& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        PLOG_ERROR << "cannot open file to read: " << path;
+        return false;
+    }
+    // length
+    in.seekg(0, std::ifstream::end);
+    int len = in.tellg();
+    in.seekg(0);
+    std::shared_ptr<char> json_str(new char[len + 1], [](char* p) { delete[] p; });
+    in.read(json_str.get(), len);
+    json_str.get()[len] = '\0';
+    // parse to json
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    Json::Value root;
+    std::string errs;
+    if (!reader->parse(json_str.get(), json_str.get() + len, &root, &errs)) {
+        // cannot parse the json by the content of file
+        return false;
+    }
+    if (!root.isArray()) {
+        return false;
+    }
+    std::vector<Record> records;
+    for (auto const& record : root) {
+        if (!record.isMember("address") || !record["address"].isString()) {
+            continue;
+        }
+        if (!record.isMember("time") || !record["time"].isIntegral()) {
+            continue;
+        }
+        records.emplace_back(record["address"].asString(), record["time"].asInt64());
+        Set(records.back().first, records.back().second);
+    }
+    PLOG_DEBUG << "read total " << records.size() << " record(s) from json file";
+    std::lock_guard save_lock(m_save_mtx);
+    return MergeIntoArchive(std::move(records));
+}
+
+void FaucetAddrMan::Update(std::string const& addr) {
+    int64_t curr = time(nullptr);
+    Set(addr, curr);
+    if (m_journal_opened) {
+        m_journal.Append(addr, curr);
+    }
+}
+
+int64_t FaucetAddrMan::Query(std::string const& addr) const {
+    {
+        Shard const& shard = GetShard(addr);
+        std::shared_lock lock(shard.mtx);
+        auto i = shard.records.find(addr);
+        if (i != std::end(shard.records)) {
+            return i->second;
+        }
+    }
+    std::shared_lock lock(m_snapshot_mtx);
+    return m_snapshot ? m_snapshot->Find(addr) : 0;
+}
+
+std::size_t FaucetAddrMan::Size() const {
+    std::size_t total{0};
+    for (auto const& shard : m_shards) {
+        std::shared_lock lock(shard.mtx);
+        total += shard.records.size();
+    }
+    return total;
+}
+
+std::size_t FaucetAddrMan::ArchiveSize() const {
+    auto snapshot = GetSnapshot();
+    return snapshot ? snapshot->Size() : 0;
+}
+
+void FaucetAddrMan::Set(std::string const& addr, int64_t time) {
+    int64_t now = ::time(nullptr);
+    if (time + m_expiry <= now) {
+        // it no longer affects any decision
+        return;
+    }
+    Shard& shard = GetShard(addr);
+    std::unique_lock lock(shard.mtx);
+    auto res = shard.records.try_emplace(addr, time);
+    if (!res.second) {
+        if (time <= res.first->second) {
+            return;
+        }
+        res.first->second = time;
+    }
+    shard.expiry_queue.emplace_back(&*res.first, time);
+    // evicting a little more than inserting keeps the shard bounded without a full sweep
+    Expire(shard, now, 2);
+}
+
+void FaucetAddrMan::Expire(Shard& shard, int64_t now, std::size_t max_num) {
+    for (std::size_t n = 0; n < max_num && !shard.expiry_queue.empty(); ++n) {
+        auto const& item = shard.expiry_queue.front();
+        if (item.second + m_expiry > now) {
+            break;
+        }
+        // only the latest queued item of a record removes it, the earlier ones are stale
+        if (item.first->second == item.second) {
+            shard.records.erase(shard.records.find(item.first->first));
+        }
+        shard.expiry_queue.pop_front();
+    }
+}
+
+void FaucetAddrMan::ExpireAll() {
+    int64_t now = time(nullptr);
+    for (auto& shard : m_shards) {
+        std::unique_lock lock(shard.mtx);
+        Expire(shard, now, shard.expiry_queue.size());
+    }
+}
+
+bool FaucetAddrMan::MergeIntoArchive(std::vector<Record> records) {
+    std::sort(std::begin(records), std::end(records));
+    auto snapshot = GetSnapshot();
+    AddrSnapshot::Entry const* p = snapshot ? snapshot->begin() : nullptr;
+    AddrSnapshot::Entry const* end = snapshot ? snapshot->end() : nullptr;
+    AddrSnapshot::Writer writer(m_db_path);
+    for (auto i = std::begin(records); i != std::end(records); ++i) {
+        // the records of the same address are adjacent, the last one has the latest time
+        if (std::next(i) != std::end(records) && std::next(i)->first == i->first) {
+            continue;
+        }
+        for (; p != end && AddrSnapshot::GetAddress(*p) < i->first; ++p) {
+            writer.Add(AddrSnapshot::GetAddress(*p), p->time);
+        }
+        int64_t time = i->second;
+        if (p != end && AddrSnapshot::GetAddress(*p) == i->first) {
+            time = std::max(time, p->time);
+            ++p;
+        }
+        writer.Add(i->first, time);
+    }
+    for (; p != end; ++p) {
+        writer.Add(AddrSnapshot::GetAddress(*p), p->time);
+    }
+    if (!writer.Commit()) {
+        return false;
+    }
+    auto new_snapshot = AddrSnapshot::Open(m_db_path);
+    if (!new_snapshot) {
+        PLOG_ERROR << "cannot map the new snapshot: " << m_db_path;
+        return false;
+    }
+    std::unique_lock lock(m_snapshot_mtx);
+    m_snapshot = std::move(new_snapshot);
+    return true;
+}
+
+std::shared_ptr<AddrSnapshot const> FaucetAddrMan::GetSnapshot() const {
+    std::shared_lock lock(m_snapshot_mtx);
+    return m_snapshot;
+}
+
+void FaucetAddrMan::BackgroundLoop(std::chrono::milliseconds sync_interval, std::chrono::seconds compact_interval) {
+    auto next_compact = std::chrono::steady_clock::now() + compact_interval;
+    std::unique_lock lock(m_bg_mtx);
+    while (!m_bg_stop) {
+        m_bg_cv.wait_for(lock, sync_interval, [this]() { return m_bg_stop; });
+        lock.unlock();
+        {
+            StageTimer timer(Metrics::Stage::DbSync);
+            if (!m_journal.Sync()) {
+                PLOG_ERROR << "cannot sync journal: " << GetJournalPath();
+            }
+        }
+        ExpireAll();
+        if (std::chrono::steady_clock::now() >= next_compact) {
+            PLOG_DEBUG << "compacting journal into " << m_db_path;
+            if (!Compact()) {
+                PLOG_ERROR << "cannot compact journal into " << m_db_path;
+            }
+            next_compact = std::chrono::steady_clock::now() + compact_interval;
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef FAUCET_ADDR_MAN_H
+#define FAUCET_ADDR_MAN_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "addr_journal.h"
+#include "addr_snapshot.h"
+
+/**
+ * Records the last fund time of each address.
+ *
+ * Only the records within the cooldown window (`expiry`) are kept in memory. They are split into lock-striped
+ * shards so that lookups from different io threads rarely contend on the same lock. Each shard also queues its
+ * records in the order of their fund time, so expired records are evicted from the front in amortized O(1).
+ *
+ * The permanent history goes to the archive: every update is appended to a journal next to the db file, a
+ * background thread syncs the journal every `sync_interval` and merges it into the db file, a binary snapshot
+ * which is mapped into memory, every `compact_interval`. Lookups missing the shards fall back to the snapshot.
+ */
+class FaucetAddrMan {
+public:
+    static const std::size_t NUM_SHARDS = 64;
+
+    explicit FaucetAddrMan(std::chrono::seconds expiry) : m_expiry(expiry.count()) {}
+
+    ~FaucetAddrMan();
+
+    /// Map the db file and replay its journals, then start journaling the updates
+    bool Open(std::string const& db_path, std::chrono::milliseconds sync_interval,
+            std::chrono::seconds compact_interval);
+
+    /// Merge the journaled records into a new db file and drop the journal
+    bool Compact();
+
+    /// Export all archived and journaled records to a json file, the file is replaced atomically
+    bool SaveToFile(std::string const& path);
+
+    /// Import the records from a json file into the archive, the newer fund time is kept for the existing addresses
+    bool LoadFromFile(std::string const& path);
+
+    void Update(std::string const& addr);
+
+    /// The last fund time of the address, 0 if it has never been funded
+    int64_t Query(std::string const& addr) const;
+
+    /// The number of records within the cooldown window
+    std::size_t Size() const;
+
+    /// The number of records in the db file
+    std::size_t ArchiveSize() const;
+
+private:
+    using Record = std::pair<std::string, int64_t>;
+
+    struct alignas(64) Shard {
+        using Map = std::unordered_map<std::string, int64_t>;
+
+        mutable std::shared_mutex mtx;
+        Map records;
+        // references of map nodes are stable, each node is queued again when its time is increased
+        std::deque<std::pair<Map::value_type*, int64_t>> expiry_queue;
+    };
+
+    Shard& GetShard(std::string const& addr) { return m_shards[std::hash<std::string>()(addr) % NUM_SHARDS]; }
+
+    Shard const& GetShard(std::string const& addr) const {
+        return m_shards[std::hash<std::string>()(addr) % NUM_SHARDS];
+    }
+
+    void Set(std::string const& addr, int64_t time);
+
+    /// Evict at most `max_num` expired records from the shard, the shard must be locked
+    void Expire(Shard& shard, int64_t now, std::size_t max_num);
+
+    void ExpireAll();
+
+    /// Merge the records with the current snapshot into a new db file, `m_save_mtx` must be locked
+    bool MergeIntoArchive(std::vector<Record> records);
+
+    std::shared_ptr<AddrSnapshot const> GetSnapshot() const;
+
+    void BackgroundLoop(std::chrono::milliseconds sync_interval, std::chrono::seconds compact_interval);
+
+    std::string GetJournalPath() const { return m_db_path + ".journal"; }
+
+    std::string GetRotatedJournalPath() const { return m_db_path + ".journal.old"; }
+
+private:
+    int64_t m_expiry;
+    std::array<Shard, NUM_SHARDS> m_shards;
+    mutable std::shared_mutex m_snapshot_mtx;
+    std::shared_ptr<AddrSnapshot const> m_snapshot;
+    std::mutex m_save_mtx;
+    std::string m_db_path;
+    AddrJournal m_journal;
+    bool m_journal_opened{false};
+    std::mutex m_bg_mtx;
+    std::condition_variable m_bg_cv;
+    bool m_bg_stop{false};
+    std::thread m_bg_thread;
+};
+
+#endif
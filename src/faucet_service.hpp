@@ -4,230 +4,814 @@
 #include <asio.hpp>
 #include <plog/Log.h>
 
+#include <cassert>
+#include <charconv>
+#include <chrono>
 #include <memory>
 #include <string>
-#include <sstream>
+#include <string_view>
+#include <vector>
 #include <functional>
-#include <deque>
 
+#include "metrics.hpp"
+#include "rate_limiter.hpp"
+#include "slab_pool.hpp"
+#include "timer_wheel.hpp"
 #include "utils.hpp"
 
 const int MAX_BUF = 1024 * 8;
+/// How many blocks of `GetRecvBufferPool` and of the session pool are carved from one slab
+const std::size_t BLOCKS_PER_SLAB = 64;
+/// The request line and all headers of one message
+const std::size_t MAX_HEADER_SIZE = 1024 * 16;
+const std::size_t MAX_HEADERS = 100;
+const std::size_t MAX_BODY_SIZE = 1024 * 64;
 
 using asio::ip::tcp;
 
 class SimpleHttpMessageParser {
 public:
+    enum class State { RequestLine, Headers, Body, Done, Error };
+
     SimpleHttpMessageParser() {}
 
-    bool Write(std::string const& msg) {
-        m_content += msg;
+    /**
+     * Append the received bytes and continue parsing from the position where the last call stopped
+     *
+     * @return true when a whole message is available
+     */
+    bool Write(char const* data, std::size_t size) {
+        m_buf.append(data, size);
         bool succ = Parse();
         if (succ) {
-            PLOG_DEBUG << "Received: " << std::endl << m_content;
+            PLOG_DEBUG << "Received: " << std::endl << std::string_view(m_buf).substr(0, m_pos);
         }
         return succ;
     }
 
-    bool ReadHeader(std::string const& name, std::string& out) const {
-        auto i = m_props.find(ToLowerCase(name));
-        if (i == std::end(m_props)) {
+    bool Write(std::string const& msg) { return Write(msg.data(), msg.size()); }
+
+    bool IsError() const { return m_state == State::Error; }
+
+    State GetState() const { return m_state; }
+
+    /// Whether some bytes of the next message are received
+    bool HasPendingBytes() const { return !m_buf.empty(); }
+
+    /**
+     * Drop the message which has been handled and start parsing the pipelined bytes behind it
+     *
+     * @return true when the next message is already available
+     */
+    bool Next() {
+        m_buf.erase(0, m_pos);
+        m_state = State::RequestLine;
+        m_msg_pos = m_pos = m_scan = 0;
+        m_content_length = 0;
+        m_headers.clear();
+        m_method_type = m_target = m_version = m_body = Span();
+        return Parse();
+    }
+
+    /// HTTP/1.1 connections are persistent unless `Connection: close`, HTTP/1.0 ones need `keep-alive`
+    bool KeepAlive() const {
+        std::string_view conn;
+        bool has_conn = ReadHeader("Connection", conn);
+        if (ReadVersion() == "HTTP/1.0") {
+            return has_conn && HasToken(conn, "keep-alive");
+        }
+        return !has_conn || !HasToken(conn, "close");
+    }
+
+    bool ReadHeader(std::string_view name, std::string_view& out) const {
+        for (auto const& header : m_headers) {
+            if (EqualsIgnoreCase(View(header.name), name)) {
+                out = View(header.value);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ReadHeader(std::string_view name, std::string& out) const {
+        std::string_view value;
+        if (!ReadHeader(name, value)) {
             return false;
         }
-        out = i->second;
+        out.assign(value);
         return true;
     }
 
-    std::string ReadBody() const { return m_body; }
+    /// The returned view refers to the receive buffer, it is valid until the parser is written again
+    std::string_view ReadBody() const { return View(m_body); }
+
+    std::string_view ReadMethodType() const { return View(m_method_type); }
+
+    std::string_view ReadTarget() const { return View(m_target); }
 
-    std::string ReadMethodType() const { return m_method_type; }
+    std::string_view ReadVersion() const { return View(m_version); }
 
 private:
-    void AnalyzeLine(std::string const& line) {
-        auto pos = line.find_first_of(':');
-        if (pos == std::string::npos) {
-            // Analyze method type
-            if (m_method_type.empty()) {
-                auto p2 = line.find_first_of(' ');
-                m_method_type = line.substr(0, p2);
+    struct Span {
+        std::size_t pos{0};
+        std::size_t len{0};
+    };
+
+    struct Header {
+        Span name;
+        Span value;
+    };
+
+    static bool HasToken(std::string_view value, std::string_view token) {
+        while (!value.empty()) {
+            auto pos = value.find(',');
+            if (EqualsIgnoreCase(TrimString(value.substr(0, pos)), token)) {
+                return true;
             }
-            m_lines.push_back(line);
-            return;
+            if (pos == std::string_view::npos) {
+                break;
+            }
+            value.remove_prefix(pos + 1);
         }
-        std::string name = ToLowerCase(line.substr(0, pos));
-        std::string value = TrimLeftString(line.substr(pos + 1));
-        m_props[name] = value;
+        return false;
+    }
+
+    std::string_view View(Span span) const { return std::string_view(m_buf).substr(span.pos, span.len); }
+
+    bool Fail(char const* reason) {
+        PLOG_ERROR << "Cannot parse http message: " << reason;
+        m_state = State::Error;
+        return false;
+    }
+
+    bool AnalyzeRequestLine(Span line) {
+        std::string_view str = View(line);
+        auto p1 = str.find(' ');
+        auto p2 = str.rfind(' ');
+        if (p1 == std::string_view::npos || p1 == p2) {
+            return Fail("invalid request line");
+        }
+        m_method_type = {line.pos, p1};
+        m_target = {line.pos + p1 + 1, p2 - p1 - 1};
+        m_version = {line.pos + p2 + 1, line.len - p2 - 1};
+        return true;
+    }
+
+    bool AnalyzeHeaderLine(Span line) {
+        std::string_view str = View(line);
+        auto pos = str.find(':');
+        if (pos == std::string_view::npos || pos == 0) {
+            return Fail("invalid header line");
+        }
+        if (m_headers.size() >= MAX_HEADERS) {
+            return Fail("too many headers");
+        }
+        std::string_view value = TrimString(str.substr(pos + 1));
+        std::size_t value_pos = value.empty() ? line.pos + str.size() : line.pos + (value.data() - str.data());
+        m_headers.push_back({{line.pos, pos}, {value_pos, value.size()}});
+        return true;
+    }
+
+    bool AnalyzeContentLength() {
+        std::string_view length_str;
+        if (!ReadHeader("Content-Length", length_str)) {
+            // cannot find the `Content-Length', there is no data
+            m_content_length = 0;
+            return true;
+        }
+        auto res = std::from_chars(length_str.data(), length_str.data() + length_str.size(), m_content_length);
+        if (res.ec != std::errc() || res.ptr != length_str.data() + length_str.size()) {
+            return Fail("invalid `Content-Length`");
+        }
+        if (m_content_length > MAX_BODY_SIZE) {
+            return Fail("body is too large");
+        }
+        return true;
     }
 
     bool Parse() {
-        auto analyze_from = std::begin(m_content);
-        auto p = analyze_from;
-        while (p != std::end(m_content)) {
-            if (*p == '\r') {
-                ++p;
-                if (*p == '\n') {
-                    ++p;
-                    // cut current line
-                    std::string line(analyze_from, p - 2);
-                    if (line.empty()) {
-                        // end of header, following bytes are the content, read length
-                        std::string length_str;
-                        if (ReadHeader("Content-Length", length_str)) {
-                            int length = std::stoi(length_str);
-                            std::string content(p, std::end(m_content));
-                            if (content.size() < length) {
-                                // wrong content
-                                return false;
-                            }
-                            m_body = std::move(content);
-                            return true;
-                        } else {
-                            // cannot find the `Content-Length', there is no data, just return
-                            return true;
+        while (true) {
+            switch (m_state) {
+                case State::RequestLine:
+                case State::Headers: {
+                    // only the bytes after the last scanned position need to be checked
+                    auto eol = m_buf.find('\n', m_scan);
+                    // measured from the start of the message, so the limit holds for all lines together
+                    if ((eol == std::string::npos ? m_buf.size() : eol + 1) - m_msg_pos > MAX_HEADER_SIZE) {
+                        return Fail("header is too large");
+                    }
+                    if (eol == std::string::npos) {
+                        m_scan = m_buf.size();
+                        return false;
+                    }
+                    Span line{m_pos, eol - m_pos};
+                    if (line.len > 0 && m_buf[eol - 1] == '\r') {
+                        --line.len;
+                    }
+                    m_pos = m_scan = eol + 1;
+                    if (m_state == State::RequestLine) {
+                        if (line.len == 0) {
+                            // leading empty lines before the request line are allowed
+                            continue;
+                        }
+                        if (!AnalyzeRequestLine(line)) {
+                            return false;
+                        }
+                        m_state = State::Headers;
+                    } else if (line.len == 0) {
+                        // end of header, following bytes are the content
+                        if (!AnalyzeContentLength()) {
+                            return false;
                         }
-                    } else {
-                        AnalyzeLine(line);
-                        analyze_from = p;
+                        m_state = State::Body;
+                    } else if (!AnalyzeHeaderLine(line)) {
+                        return false;
                     }
+                    break;
                 }
-            } else {
-                ++p;
+                case State::Body:
+                    if (m_buf.size() - m_pos < m_content_length) {
+                        return false;
+                    }
+                    m_body = {m_pos, m_content_length};
+                    m_pos += m_content_length;
+                    m_scan = m_pos;
+                    m_state = State::Done;
+                    return true;
+                case State::Done:
+                    return true;
+                case State::Error:
+                    return false;
             }
         }
-        return false;
     }
 
 private:
-    std::string m_content;
-    std::vector<std::string> m_lines;
-    std::map<std::string, std::string> m_props;
+    std::string m_buf;
+    State m_state{State::RequestLine};
+    // where the current message starts in the buffer
+    std::size_t m_msg_pos{0};
+    std::size_t m_pos{0};
+    std::size_t m_scan{0};
+    std::size_t m_content_length{0};
+    std::vector<Header> m_headers;
+    Span m_method_type;
+    Span m_target;
+    Span m_version;
+    Span m_body;
+};
+
+/**
+ * A response ready to be sent. The status line and the header fragments refer to static storage, only the content
+ * length is formatted into the response itself and the body is either moved in or static, so a response with a fixed
+ * text doesn't allocate at all.
+ */
+class SimpleHttpResponse {
+public:
+    static const std::size_t NUM_BUFFERS = 7;
+
+    /// Append the fragments of the response to the buffer sequence of a gathered write
+    void AppendBuffers(std::vector<asio::const_buffer>& bufs) const {
+        bufs.emplace_back(m_status_line.data(), m_status_line.size());
+        bufs.emplace_back(CONTENT_TYPE.data(), CONTENT_TYPE.size());
+        bufs.emplace_back(m_content_type.data(), m_content_type.size());
+        bufs.emplace_back(CONTENT_LENGTH.data(), CONTENT_LENGTH.size());
+        bufs.emplace_back(m_content_length, m_content_length_size);
+        bufs.emplace_back(m_connection.data(), m_connection.size());
+        std::string_view body = Body();
+        bufs.emplace_back(body.data(), body.size());
+    }
+
+    std::size_t Size() const {
+        return m_status_line.size() + CONTENT_TYPE.size() + m_content_type.size() + CONTENT_LENGTH.size() +
+               m_content_length_size + m_connection.size() + Body().size();
+    }
+
+    /// The whole response in one string, it allocates and is only meant for logging and tools
+    std::string ToString() const {
+        std::vector<asio::const_buffer> bufs;
+        AppendBuffers(bufs);
+        std::string str;
+        str.reserve(Size());
+        for (auto const& buf : bufs) {
+            str.append(static_cast<char const*>(buf.data()), buf.size());
+        }
+        return str;
+    }
+
+private:
+    friend class SimpleHttpMessageBuilder;
+
+    static constexpr std::string_view CONTENT_TYPE = "Content-Type: ";
+    static constexpr std::string_view CONTENT_LENGTH = "\r\nContent-Length: ";
+
+    std::string_view Body() const { return m_static_body.data() ? m_static_body : std::string_view(m_body); }
+
+private:
+    std::string_view m_status_line;
+    std::string_view m_content_type;
+    // enough for the digits of a 64-bit length and the line break
+    char m_content_length[24];
+    std::size_t m_content_length_size{0};
+    std::string_view m_connection;
     std::string m_body;
-    std::string m_method_type;
+    std::string_view m_static_body;
 };
 
 class SimpleHttpMessageBuilder {
 public:
-    void WriteContent(std::string const& content, std::string const& content_type) {
-        m_ss << "HTTP/1.1 200 OK\r\n";
-        m_ss << "Content-Type: " << content_type << "\r\n";
-        m_ss << "Content-Length: " << std::to_string(content.size()) << "\r\n";
-        m_ss << "\r\n";
-        m_ss << content;
+    explicit SimpleHttpMessageBuilder(bool keep_alive = true) : m_keep_alive(keep_alive) {}
+
+    /// The content is moved into the response, `content_type` must refer to static storage
+    void WriteContent(std::string content, std::string_view content_type, int status = 200) {
+        m_msg.m_body = std::move(content);
+        WriteHeaders(m_msg.m_body.size(), content_type, status);
+    }
+
+    /// Both `content` and `content_type` must refer to static storage, nothing is copied
+    void WriteStaticContent(std::string_view content, std::string_view content_type, int status = 200) {
+        m_msg.m_static_body = content.data() ? content : std::string_view("", 0);
+        WriteHeaders(content.size(), content_type, status);
     }
 
-    std::string GetMessage() const { return m_ss.str(); }
+    SimpleHttpResponse TakeMessage() { return std::move(m_msg); }
 
 private:
-    std::stringstream m_ss;
+    void WriteHeaders(std::size_t content_length, std::string_view content_type, int status) {
+        m_msg.m_status_line = StatusLine(status);
+        m_msg.m_content_type = content_type;
+        char* begin = m_msg.m_content_length;
+        char* end = std::to_chars(begin, begin + sizeof(m_msg.m_content_length) - 2, content_length).ptr;
+        *end++ = '\r';
+        *end++ = '\n';
+        m_msg.m_content_length_size = end - begin;
+        m_msg.m_connection = m_keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    }
+
+    static std::string_view StatusLine(int status) {
+        switch (status) {
+            case 200:
+                return "HTTP/1.1 200 OK\r\n";
+            case 202:
+                return "HTTP/1.1 202 Accepted\r\n";
+            case 400:
+                return "HTTP/1.1 400 Bad Request\r\n";
+            case 404:
+                return "HTTP/1.1 404 Not Found\r\n";
+            case 429:
+                return "HTTP/1.1 429 Too Many Requests\r\n";
+            case 500:
+                return "HTTP/1.1 500 Internal Server Error\r\n";
+            case 503:
+                return "HTTP/1.1 503 Service Unavailable\r\n";
+            default:
+                assert(false && "unknown status");
+                return "HTTP/1.1 500 Internal Server Error\r\n";
+        }
+    }
+
+private:
+    bool m_keep_alive;
+    SimpleHttpResponse m_msg;
+};
+
+struct ServiceOptions {
+    int max_requests_per_conn{100};
+    /// New connections are shed once this many sessions are open, 0 disables the limit
+    int max_sessions{10000};
+    /// The request line and the headers must arrive within this time from their first byte, 0 disables each timeout
+    std::chrono::seconds header_timeout{10};
+    /// The body must arrive within this time from the end of the headers
+    std::chrono::seconds body_timeout{30};
+    /// A keep-alive connection is closed when the next request does not start within this time
+    std::chrono::seconds idle_timeout{15};
+    /// The connection is closed when the handler has not answered a request within this time
+    std::chrono::seconds response_timeout{60};
+    RateLimiter::Options rate_limit;
 };
 
-class Session : public std::enable_shared_from_this<Session> {
+/**
+ * The options, the deadlines and the number of open sessions of one service. The sessions share it with the service
+ * because they can outlive the service while the io_context is torn down.
+ */
+class SessionGroup {
+public:
+    SessionGroup(asio::io_context& ioc, ServiceOptions const& opts)
+        : m_opts(opts), m_wheel(ioc, DEADLINE_TICK, DEADLINE_SLOTS) {
+        m_wheel.Start();
+    }
+
+    ServiceOptions const& GetOptions() const { return m_opts; }
+
+    TimerWheel& GetWheel() { return m_wheel; }
+
+    /// Only the accepting handler adds sessions, so the limit is never overshot
+    bool Full() const {
+        return m_opts.max_sessions > 0 && m_num_sessions.load(std::memory_order_relaxed) >= m_opts.max_sessions;
+    }
+
+    void Add() { m_num_sessions.fetch_add(1, std::memory_order_relaxed); }
+
+    void Remove() { m_num_sessions.fetch_sub(1, std::memory_order_relaxed); }
+
+private:
+    static constexpr std::chrono::milliseconds DEADLINE_TICK{250};
+    static std::size_t const DEADLINE_SLOTS = 512;
+
+    ServiceOptions m_opts;
+    TimerWheel m_wheel;
+    std::atomic<int> m_num_sessions{0};
+};
+
+class Session : public std::enable_shared_from_this<Session>, private TimerWheel::Entry {
 public:
     using Callback = std::function<void(bool, SimpleHttpMessageParser const&)>;
 
-    explicit Session(tcp::socket&& s) : m_s(std::move(s)) {}
+    Session(tcp::socket&& s, std::shared_ptr<SessionGroup> pgroup) : m_s(std::move(s)), m_pgroup(std::move(pgroup)) {
+        m_pgroup->Add();
+        GetMetrics().Add(Metrics::Gauge::OpenSessions, 1);
+        // the reads are done by `read_some` once the socket is readable, they must not block the io thread
+        asio::error_code ignored_ec;
+        m_s.non_blocking(true, ignored_ec);
+    }
 
-    ~Session() { PLOGD << "Session is going to be free"; }
+    ~Session() {
+        PLOGD << "Session is going to be free";
+        m_pgroup->GetWheel().Cancel(*this);
+        LeaveGroup();
+        GetMetrics().Add(Metrics::Gauge::WriteQueueDepth,
+                -static_cast<int64_t>(m_queued_msgs.size() + m_writing_msgs.size()));
+    }
 
     void Start(Callback callback) {
         m_callback = std::move(callback);
         ReadNext();
     }
 
-    void Write(std::string const& msg) {
-        bool write = m_writing_msgs.empty();
-        m_writing_msgs.push_back(msg);
-        if (write) {
+    /// Whether the connection stays open after the response of the current message
+    bool KeepAlive() const { return m_keep_alive; }
+
+    /// Queue the response of the current message, the next pipelined message is handled after it. It can be called
+    /// from any thread, the response is queued on the session's strand.
+    void Write(SimpleHttpResponse msg) {
+        asio::dispatch(m_s.get_executor(), [self = shared_from_this(), msg = std::move(msg)]() mutable {
+            self->DoWrite(std::move(msg));
+        });
+    }
+
+private:
+    void DoWrite(SimpleHttpResponse msg) {
+        if (!m_s.is_open()) {
+            // the response came after the connection is timed out
+            return;
+        }
+        m_queued_msgs.push_back(std::move(msg));
+        GetMetrics().Add(Metrics::Gauge::WriteQueueDepth, 1);
+        if (m_writing_msgs.empty()) {
             WriteNext();
         }
+        if (m_processing) {
+            m_processing = false;
+            if (m_keep_alive) {
+                // the next message starts its own deadline
+                SetPhase(Phase::None);
+                asio::post(m_s.get_executor(), [self = shared_from_this()]() { self->ProcessNext(); });
+            } else {
+                // the peer has to take the last response before the connection is idle for too long
+                SetPhase(Phase::Idle);
+            }
+        }
+    }
+
+    /// The part of the connection which is awaited, each one has its own deadline
+    enum class Phase { None, Idle, Header, Body, Response };
+
+    /**
+     * Start the deadline of a new phase, the deadline keeps running while the same phase trickles in. The first
+     * message of a connection is in the header phase from the accept.
+     */
+    void SetPhase(Phase phase) {
+        if (phase == m_phase) {
+            return;
+        }
+        m_phase = phase;
+        ServiceOptions const& opts = m_pgroup->GetOptions();
+        std::chrono::seconds timeout{0};
+        if (phase == Phase::Idle) {
+            timeout = opts.idle_timeout;
+        } else if (phase == Phase::Header) {
+            timeout = opts.header_timeout;
+        } else if (phase == Phase::Body) {
+            timeout = opts.body_timeout;
+        } else if (phase == Phase::Response) {
+            timeout = opts.response_timeout;
+        }
+        if (timeout.count() > 0) {
+            m_deadline = TimerWheel::Clock::now() + timeout;
+            m_pgroup->GetWheel().Schedule(*this, timeout);
+        } else {
+            m_phase = Phase::None;
+            m_pgroup->GetWheel().Cancel(*this);
+        }
+    }
+
+    void OnExpired() override {
+        asio::post(m_s.get_executor(), [pweak_self = weak_from_this()]() {
+            if (auto self = pweak_self.lock()) {
+                self->Expire();
+            }
+        });
+    }
+
+    void Expire() {
+        // the wheel can fire for a deadline which has been replaced meanwhile
+        if (m_phase == Phase::None || TimerWheel::Clock::now() < m_deadline) {
+            return;
+        }
+        GetMetrics().Inc(Metrics::Outcome::Timeout);
+        if (m_phase == Phase::Response) {
+            PLOG_ERROR << "Request is not answered in time, the connection is closed";
+        } else {
+            PLOG_DEBUG << "Session is timed out";
+        }
+        Close();
     }
 
-private:
     void ReadNext() {
-        // Start to read until end-of-file
-        m_s.async_read_some(
-                asio::buffer(m_buf, MAX_BUF),
-                [self = shared_from_this()](std::error_code const& ec, std::size_t total_read) {
+        if (m_parser.GetState() == SimpleHttpMessageParser::State::Body) {
+            SetPhase(Phase::Body);
+        } else if (m_num_requests == 0 || m_parser.HasPendingBytes()) {
+            SetPhase(Phase::Header);
+        } else {
+            SetPhase(Phase::Idle);
+        }
+        // wait until the peer sends something, an idle connection holds no receive buffer
+        m_s.async_wait(tcp::socket::wait_read,
+                MakeAllocHandler(m_read_mem, [self = shared_from_this()](std::error_code const& ec) {
                     if (ec) {
-                        if (ec == asio::error::eof) {
-                            // done!
-                        } else {
-                            PLOG_ERROR << "Peer read error: " << ec.message();
+                        if (ec != asio::error::operation_aborted) {
+                            PLOG_ERROR << "Peer wait error: " << ec.message();
                         }
                         return;
                     }
-                    // append all read content to buffer
-                    if (self->m_parser.Write(std::string(self->m_buf, self->m_buf + total_read))) {
-                        // a whole message is read
-                        self->m_callback(true, self->m_parser);
-                        return;
-                    }
-                    self->ReadNext();
-                });
+                    self->ReadAvailable();
+                }));
     }
 
+    void ReadAvailable() {
+        bool done;
+        {
+            // the buffer only lives for this read, the parser keeps its own copy of the bytes
+            SlabBlock buf(GetRecvBufferPool());
+            asio::error_code ec;
+            std::size_t total_read = m_s.read_some(asio::buffer(buf.Get(), MAX_BUF), ec);
+            if (ec == asio::error::would_block || ec == asio::error::try_again) {
+                ReadNext();
+                return;
+            }
+            if (ec) {
+                if (ec == asio::error::eof) {
+                    // done!
+                } else {
+                    PLOG_ERROR << "Peer read error: " << ec.message();
+                }
+                return;
+            }
+            // append all read content to buffer
+            auto parse_start = std::chrono::steady_clock::now();
+            done = m_parser.Write(static_cast<char const*>(buf.Get()), total_read);
+            m_parse_time += std::chrono::steady_clock::now() - parse_start;
+        }
+        if (done) {
+            // a whole message is read
+            Dispatch();
+            return;
+        }
+        if (m_parser.IsError()) {
+            DispatchError();
+            return;
+        }
+        ReadNext();
+    }
+
+    static SlabPool& GetRecvBufferPool() {
+        static SlabPool pool(MAX_BUF, BLOCKS_PER_SLAB);
+        return pool;
+    }
+
+    void ProcessNext() {
+        auto parse_start = std::chrono::steady_clock::now();
+        bool done = m_parser.Next();
+        m_parse_time += std::chrono::steady_clock::now() - parse_start;
+        if (done) {
+            // the pipelined message is already received
+            Dispatch();
+        } else if (m_parser.IsError()) {
+            DispatchError();
+        } else {
+            ReadNext();
+        }
+    }
+
+    void Dispatch() {
+        GetMetrics().Observe(Metrics::Stage::Parse, m_parse_time);
+        m_parse_time = {};
+        ++m_num_requests;
+        m_keep_alive = m_parser.KeepAlive() && m_num_requests < m_pgroup->GetOptions().max_requests_per_conn;
+        m_processing = true;
+        // a handler which never answers must not hold the connection forever
+        SetPhase(Phase::Response);
+        m_callback(true, m_parser);
+    }
+
+    void DispatchError() {
+        m_keep_alive = false;
+        m_processing = true;
+        SetPhase(Phase::Response);
+        m_callback(false, m_parser);
+    }
+
+    /// Send all queued responses with one gathered write, the responses queued meanwhile are sent by the next one
     void WriteNext() {
-        if (m_writing_msgs.empty()) {
+        if (m_queued_msgs.empty()) {
+            if (!m_keep_alive && !m_processing) {
+                Close();
+            }
             return;
         }
-        std::string const& msg = m_writing_msgs.front();
-        asio::async_write(
-                m_s, asio::buffer(msg),
-                [self = shared_from_this(), &msg](std::error_code const& ec, std::size_t total_wrote) {
+        // both vectors keep their capacity, a busy session stops allocating for its writes
+        std::swap(m_writing_msgs, m_queued_msgs);
+        m_write_bufs.clear();
+        for (auto const& msg : m_writing_msgs) {
+            msg.AppendBuffers(m_write_bufs);
+        }
+        asio::async_write(m_s, m_write_bufs,
+                MakeAllocHandler(m_write_mem, [self = shared_from_this(), start = std::chrono::steady_clock::now()](
+                                                      std::error_code const& ec, std::size_t) {
+                    GetMetrics().Observe(Metrics::Stage::Write, std::chrono::steady_clock::now() - start);
                     if (ec) {
                         PLOG_ERROR << "Peer write error: " << ec.message();
                         return;
                     }
-                    assert(total_wrote == msg.size());
-                    self->m_writing_msgs.pop_front();
+                    GetMetrics().Add(
+                            Metrics::Gauge::WriteQueueDepth, -static_cast<int64_t>(self->m_writing_msgs.size()));
+                    self->m_writing_msgs.clear();
                     self->WriteNext();
-                });
+                }));
+    }
+
+    void Close() {
+        asio::error_code ignored_ec;
+        m_s.shutdown(tcp::socket::shutdown_both, ignored_ec);
+        m_s.close(ignored_ec);
+        // a handler can still hold the session, its slot is given back with the socket
+        LeaveGroup();
+    }
+
+    void LeaveGroup() {
+        if (m_in_group) {
+            m_in_group = false;
+            m_pgroup->Remove();
+            GetMetrics().Add(Metrics::Gauge::OpenSessions, -1);
+        }
     }
 
 private:
-    char m_buf[MAX_BUF];
     tcp::socket m_s;
+    std::shared_ptr<SessionGroup> m_pgroup;
     Callback m_callback;
     SimpleHttpMessageParser m_parser;
-    std::deque<std::string> m_writing_msgs;
+    std::vector<SimpleHttpResponse> m_queued_msgs;
+    std::vector<SimpleHttpResponse> m_writing_msgs;
+    std::vector<asio::const_buffer> m_write_bufs;
+    HandlerMemory m_read_mem;
+    HandlerMemory m_write_mem;
+    std::chrono::steady_clock::duration m_parse_time{};
+    int m_num_requests{0};
+    bool m_processing{false};
+    bool m_keep_alive{true};
+    bool m_in_group{true};
+    Phase m_phase{Phase::None};
+    TimerWheel::Clock::time_point m_deadline;
 };
 
 class Service {
 public:
-    using Callback = std::function<void(Session*, SimpleHttpMessageParser const&)>;
+    using Callback = std::function<void(std::shared_ptr<Session> const&, SimpleHttpMessageParser const&)>;
 
-    Service(asio::io_context& ioc, tcp::endpoint const& endpoint, Callback callback)
-        : m_ioc(ioc), m_acceptor(ioc, endpoint), m_callback(std::move(callback)) {
+    Service(asio::io_context& ioc, tcp::endpoint const& endpoint, Callback callback, ServiceOptions opts = {})
+        : m_ioc(ioc),
+          m_acceptor(ioc, endpoint),
+          m_callback(std::move(callback)),
+          m_pgroup(std::make_shared<SessionGroup>(ioc, opts)),
+          m_rate_limiter(opts.rate_limit) {
         AcceptNext();
     }
 
+    /// The bound endpoint, the port is known here when port 0 is given
+    tcp::endpoint GetLocalEndpoint() const { return m_acceptor.local_endpoint(); }
+
 private:
     void AcceptNext() {
-        m_acceptor.async_accept([this](std::error_code const& ec, tcp::socket&& s) {
+        // every session gets its own strand so its handlers never run concurrently
+        m_acceptor.async_accept(asio::make_strand(m_ioc), [this](std::error_code const& ec, tcp::socket&& s) {
             if (ec) {
                 PLOG_ERROR << "Handle new session error: " << ec.message();
                 return;
             }
-            auto psession = std::make_shared<Session>(std::move(s));
-            psession->Start([this, pweak_session = std::weak_ptr(psession)](bool succ, SimpleHttpMessageParser const& parser) {
-                if (succ) {
-                    // should pass it to parent
-                    auto psession = pweak_session.lock();
-                    if (psession) {
-                        m_callback(psession.get(), parser);
-                    }
-                } else {
-                    // TODO sorry, it didn't work
+            // over the limit the connection is turned away before anything else is spent on it
+            if (m_pgroup->Full()) {
+                GetMetrics().Inc(Metrics::Outcome::Shed);
+                Shed(std::move(s));
+                AcceptNext();
+                return;
+            }
+            asio::error_code remote_ec;
+            asio::ip::address remote_addr = s.remote_endpoint(remote_ec).address();
+            if (remote_ec) {
+                PLOG_ERROR << "Cannot read the remote endpoint of new session: " << remote_ec.message();
+                AcceptNext();
+                return;
+            }
+            // clients which are already over the limit are turned away before anything is read
+            if (!m_rate_limiter.Allow(remote_addr)) {
+                GetMetrics().Inc(Metrics::Outcome::RateLimited);
+                RejectTooManyRequests(std::move(s));
+                AcceptNext();
+                return;
+            }
+            auto psession =
+                    std::allocate_shared<Session>(SlabAllocator<Session, BLOCKS_PER_SLAB>(), std::move(s), m_pgroup);
+            psession->Start([this, pweak_session = std::weak_ptr(psession), remote_addr](
+                                    bool succ, SimpleHttpMessageParser const& parser) {
+                auto psession = pweak_session.lock();
+                if (!psession) {
+                    return;
+                }
+                if (!succ) {
+                    GetMetrics().Inc(Metrics::Outcome::BadRequest);
+                    SimpleHttpMessageBuilder msg_builder(false);
+                    msg_builder.WriteStaticContent("Bad request.", "text/html", 400);
+                    psession->Write(msg_builder.TakeMessage());
+                    return;
+                }
+                // the metrics are served by the service itself and are not limited
+                if (parser.ReadMethodType() == "GET" && parser.ReadTarget() == "/metrics") {
+                    SimpleHttpMessageBuilder msg_builder(psession->KeepAlive());
+                    msg_builder.WriteContent(GetMetrics().Render(), "text/plain; version=0.0.4");
+                    psession->Write(msg_builder.TakeMessage());
+                    return;
+                }
+                // every request takes a token before its body is parsed
+                if (!m_rate_limiter.Consume(remote_addr)) {
+                    GetMetrics().Inc(Metrics::Outcome::RateLimited);
+                    PLOG_DEBUG << "Client " << remote_addr.to_string() << " is over the rate limit";
+                    SimpleHttpMessageBuilder msg_builder(psession->KeepAlive());
+                    msg_builder.WriteStaticContent("Too many requests.", "text/html", 429);
+                    psession->Write(msg_builder.TakeMessage());
+                    return;
                 }
+                // should pass it to parent
+                m_callback(psession, parser);
             });
             AcceptNext();
         });
     }
 
+    /// One non-blocking send of the reply, it is dropped when the socket cannot take it at once
+    static void Shed(tcp::socket&& s) {
+        static std::string const msg = []() {
+            SimpleHttpMessageBuilder msg_builder(false);
+            msg_builder.WriteStaticContent("Service is busy.", "text/html", 503);
+            return msg_builder.TakeMessage().ToString();
+        }();
+        asio::error_code ignored_ec;
+        s.non_blocking(true, ignored_ec);
+        s.send(asio::buffer(msg), 0, ignored_ec);
+        s.shutdown(tcp::socket::shutdown_both, ignored_ec);
+        s.close(ignored_ec);
+    }
+
+    void RejectTooManyRequests(tcp::socket&& s) {
+        static std::string const msg = []() {
+            SimpleHttpMessageBuilder msg_builder(false);
+            msg_builder.WriteStaticContent("Too many requests.", "text/html", 429);
+            return msg_builder.TakeMessage().ToString();
+        }();
+        auto ps = std::make_shared<tcp::socket>(std::move(s));
+        asio::async_write(*ps, asio::buffer(msg), [ps](std::error_code const&, std::size_t) {
+            asio::error_code ignored_ec;
+            ps->shutdown(tcp::socket::shutdown_both, ignored_ec);
+            ps->close(ignored_ec);
+        });
+    }
+
 private:
     asio::io_context& m_ioc;
     tcp::acceptor m_acceptor;
     Callback m_callback;
+    std::shared_ptr<SessionGroup> m_pgroup;
+    RateLimiter m_rate_limiter;
 };
 
 #endif
@@ -1,34 +1,33 @@
 #include "http_client.h"
 
+#include <cstring>
+#include <sstream>
+
 #include <plog/Log.h>
 #include <plog/Logger.h>
 #include "curl/curl.h"
 #include "curl/easy.h"
 
-HTTPClient::HTTPClient(std::string url, std::string user, std::string passwd, bool no_proxy)
+HTTPClient::HTTPClient(std::string url, std::string user, std::string passwd, bool no_proxy, bool verbose)
         : m_curl(curl_easy_init()),
           m_url(std::move(url)),
           m_user(std::move(user)),
           m_passwd(std::move(passwd)),
           m_no_proxy(no_proxy) {
-    PLOG_DEBUG << "Contruct HTTPClient with url=`" << m_url << "`, user=`" << m_user << "`, passwd=`" << m_passwd
-               << "`";
-}
-
-HTTPClient::~HTTPClient() { curl_easy_cleanup(m_curl); }
-
-std::tuple<bool, int, std::string> HTTPClient::Send(std::string const& buff) {
+    PLOG_DEBUG << "Contruct HTTPClient with url=`" << m_url << "`, user=`" << m_user << "`";
     curl_easy_setopt(m_curl, CURLOPT_URL, m_url.c_str());
 
-    curl_slist* header_list;
-    header_list = curl_slist_append(nullptr, "Content-Type: application/json-rpc");
-    header_list = curl_slist_append(header_list, "Accept: application/json");
-    curl_easy_setopt(m_curl, CURLOPT_HTTPHEADER, header_list);
+    m_header_list = curl_slist_append(nullptr, "Content-Type: application/json-rpc");
+    m_header_list = curl_slist_append(m_header_list, "Accept: application/json");
+    curl_easy_setopt(m_curl, CURLOPT_HTTPHEADER, m_header_list);
     curl_easy_setopt(m_curl, CURLOPT_POST, 1L);
-    curl_easy_setopt(m_curl, CURLOPT_POSTFIELDS, buff.c_str());
     curl_easy_setopt(m_curl, CURLOPT_USERNAME, m_user.c_str());
     curl_easy_setopt(m_curl, CURLOPT_PASSWORD, m_passwd.c_str());
-    curl_easy_setopt(m_curl, CURLOPT_POSTFIELDSIZE, buff.size());
+    // keep the connection to the node alive between requests
+    curl_easy_setopt(m_curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    // an unreachable node fails fast instead of the default 300 seconds, so the call can fail over
+    curl_easy_setopt(m_curl, CURLOPT_CONNECTTIMEOUT_MS, 5000L);
+    curl_easy_setopt(m_curl, CURLOPT_NOSIGNAL, 1L);
 
     if (m_no_proxy) {
         PLOG_DEBUG << "Disabling proxy...";
@@ -37,17 +36,30 @@ std::tuple<bool, int, std::string> HTTPClient::Send(std::string const& buff) {
         }
     }
 
-    if (plog::get()->getMaxSeverity() >= plog::Severity::debug) {
+    if (verbose) {
         curl_easy_setopt(m_curl, CURLOPT_VERBOSE, 1L);
     }
 
     curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, this);
     curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, &HTTPClient::RecvCallback);
+}
+
+HTTPClient::~HTTPClient() {
+    curl_easy_cleanup(m_curl);
+    curl_slist_free_all(m_header_list);
+}
+
+std::tuple<bool, int, std::string> HTTPClient::Send(std::string const& buff) {
+    m_recv_data.clear();
+    curl_easy_setopt(m_curl, CURLOPT_POSTFIELDS, buff.c_str());
+    curl_easy_setopt(m_curl, CURLOPT_POSTFIELDSIZE, buff.size());
 
     CURLcode code = curl_easy_perform(m_curl);
     PLOG_DEBUG << "curl_easy_perform returns " << code << ": " << curl_easy_strerror(code);
-
-    curl_slist_free_all(header_list);
+    long num_connects{0};
+    if (curl_easy_getinfo(m_curl, CURLINFO_NUM_CONNECTS, &num_connects) == CURLE_OK) {
+        m_num_connects += num_connects;
+    }
 
     if (code != CURLE_OK) {
         std::stringstream ss;
@@ -58,12 +70,8 @@ std::tuple<bool, int, std::string> HTTPClient::Send(std::string const& buff) {
     return std::make_tuple(true, code, "");
 }
 
-Bytes HTTPClient::GetReceivedData() const { return m_recv_data; }
-
 void HTTPClient::AppendRecvData(char const* ptr, size_t total) {
-    size_t offset = m_recv_data.size();
-    m_recv_data.resize(offset + total);
-    memcpy(m_recv_data.data() + offset, ptr, total);
+    m_recv_data.append(ptr, total);
 }
 
 size_t HTTPClient::RecvCallback(char* ptr, size_t size, size_t nmemb, void* userdata) {
@@ -4,19 +4,33 @@
 #include <curl/curl.h>
 
 #include <string>
+#include <string_view>
 #include <tuple>
 
 #include "types.hpp"
 
+/**
+ * A long-lived curl handle, the options and the header list are prepared once so that following requests reuse the
+ * connection kept by the handle
+ */
 class HTTPClient {
 public:
-    HTTPClient(std::string url, std::string user, std::string passwd, bool no_proxy);
+    /// `verbose` lets curl print the traffic to stderr, it bypasses the log pipeline
+    HTTPClient(std::string url, std::string user, std::string passwd, bool no_proxy, bool verbose = false);
 
     ~HTTPClient();
 
+    HTTPClient(HTTPClient const&) = delete;
+
+    HTTPClient& operator=(HTTPClient const&) = delete;
+
     std::tuple<bool, int, std::string> Send(std::string const& buff);
 
-    Bytes GetReceivedData() const;
+    /// The body of the last response, it is valid until the next `Send`
+    std::string_view GetReceivedData() const { return m_recv_data; }
+
+    /// How many connections the handle has opened, it stays at one while the node keeps the connection
+    long GetNumConnects() const { return m_num_connects; }
 
 private:
     void AppendRecvData(char const* ptr, size_t total);
@@ -27,13 +41,15 @@ private:
 
 private:
     CURL* m_curl;
+    curl_slist* m_header_list{nullptr};
     std::string m_url;
     std::string m_user;
     std::string m_passwd;
     bool m_no_proxy;
     Bytes m_send_data;
     size_t m_send_data_offset{0};
-    Bytes m_recv_data;
+    std::string m_recv_data;
+    long m_num_connects{0};
 };
 
 #endif
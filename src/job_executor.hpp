@@ -0,0 +1,90 @@
+#ifndef FAUCET_JOB_EXECUTOR_HPP
+#define FAUCET_JOB_EXECUTOR_HPP
+
+#include <asio.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+
+#include "metrics.hpp"
+#include "payout_batcher.h"
+#include "payout_jobs.h"
+
+/**
+ * Drains the payout jobs into the batcher at `rate` jobs per second with a burst of one second, and at most
+ * `max_in_flight` jobs are paid at once, so a burst of requests reaches the wallet as a steady flow
+ */
+class JobExecutor {
+public:
+    JobExecutor(asio::io_context& ioc, asio::thread_pool& rpc_pool, PayoutJobs& jobs, PayoutBatcher& batcher,
+            double rate, int max_in_flight)
+        : m_timer(asio::make_strand(ioc)),
+          m_rpc_pool(rpc_pool),
+          m_jobs(jobs),
+          m_batcher(batcher),
+          m_rate(rate),
+          m_burst(std::max(1.0, rate)),
+          m_max_in_flight(std::max(1, max_in_flight)) {}
+
+    void Start() {
+        m_last_refill = std::chrono::steady_clock::now();
+        ScheduleTick();
+    }
+
+private:
+    static constexpr std::chrono::milliseconds TICK{100};
+
+    void ScheduleTick() {
+        m_timer.expires_after(TICK);
+        m_timer.async_wait([this](std::error_code const& ec) {
+            if (ec == asio::error::operation_aborted) {
+                return;
+            }
+            Tick();
+        });
+    }
+
+    void Tick() {
+        auto now = std::chrono::steady_clock::now();
+        m_tokens = std::min(m_burst, m_tokens + m_rate * std::chrono::duration<double>(now - m_last_refill).count());
+        m_last_refill = now;
+        int room = m_max_in_flight - m_in_flight.load(std::memory_order_relaxed);
+        auto num = static_cast<std::size_t>(std::max(0.0, std::min(std::floor(m_tokens), static_cast<double>(room))));
+        if (num == 0 || m_jobs.QueueSize() == 0) {
+            ScheduleTick();
+            return;
+        }
+        // the jobs are synced as sending before they are paid, which blocks on the disk
+        asio::post(m_rpc_pool, [this, num]() {
+            auto jobs = m_jobs.Take(num);
+            m_in_flight.fetch_add(static_cast<int>(jobs.size()), std::memory_order_relaxed);
+            for (auto const& job : jobs) {
+                m_batcher.Submit(job.address, [this, id = job.id](bool succ, std::string const& txid_or_err) {
+                    GetMetrics().Inc(succ ? Metrics::Counter::JobsSent : Metrics::Counter::JobsFailed);
+                    m_jobs.Finish(id, succ, txid_or_err);
+                    m_in_flight.fetch_sub(1, std::memory_order_relaxed);
+                });
+            }
+            asio::post(m_timer.get_executor(), [this, num_taken = jobs.size()]() {
+                m_tokens -= static_cast<double>(num_taken);
+                ScheduleTick();
+            });
+        });
+    }
+
+    asio::steady_timer m_timer;
+    asio::thread_pool& m_rpc_pool;
+    PayoutJobs& m_jobs;
+    PayoutBatcher& m_batcher;
+    double m_rate;
+    double m_burst;
+    int m_max_in_flight;
+    double m_tokens{0};
+    std::chrono::steady_clock::time_point m_last_refill;
+    std::atomic<int> m_in_flight{0};
+};
+
+#endif
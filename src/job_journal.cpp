@@ -0,0 +1,64 @@
+#include "job_journal.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <plog/Log.h>
+
+std::size_t JobJournal::Replay(std::string const& path, ReplayCallback const& callback) {
+    return RecordJournal::Replay(path, sizeof(Record), MAGIC, [&callback](void const* p) {
+        Record record;
+        memcpy(&record, p, sizeof(record));
+        if (record.state < static_cast<uint8_t>(JobState::Queued) ||
+                record.state > static_cast<uint8_t>(JobState::Failed)) {
+            PLOG_ERROR << "payout job " << record.id << " has an unknown state " << static_cast<int>(record.state);
+            return;
+        }
+        Entry entry{record.id, record.time, static_cast<JobState>(record.state),
+                std::string(record.addr, std::min<std::size_t>(record.addr_len, ADDR_MAX_LEN)),
+                std::string(record.msg, std::min<std::size_t>(record.msg_len, MSG_MAX_LEN))};
+        callback(entry);
+    });
+}
+
+bool JobJournal::Rewrite(std::string const& path, std::vector<Entry> const& entries, uint64_t num_covered) {
+    std::vector<Record> records;
+    records.reserve(entries.size());
+    for (auto const& entry : entries) {
+        Record record;
+        if (MakeRecord(entry, record)) {
+            records.push_back(record);
+        }
+    }
+    return m_file.Rewrite(path, records.data(), records.size(), num_covered);
+}
+
+bool JobJournal::Append(Entry const& entry) {
+    Record record;
+    if (!MakeRecord(entry, record)) {
+        return false;
+    }
+    m_file.Append(&record);
+    return true;
+}
+
+bool JobJournal::Sync() {
+    return m_file.Sync();
+}
+
+bool JobJournal::MakeRecord(Entry const& entry, Record& out_record) {
+    if (entry.address.size() > ADDR_MAX_LEN) {
+        PLOG_ERROR << "address is too long to be journaled: " << entry.address;
+        return false;
+    }
+    std::size_t msg_len = std::min(entry.message.size(), MSG_MAX_LEN);
+    memset(&out_record, 0, sizeof(out_record));
+    out_record.id = entry.id;
+    out_record.time = entry.time;
+    out_record.state = static_cast<uint8_t>(entry.state);
+    out_record.addr_len = static_cast<uint8_t>(entry.address.size());
+    memcpy(out_record.addr, entry.address.data(), entry.address.size());
+    out_record.msg_len = static_cast<uint8_t>(msg_len);
+    memcpy(out_record.msg, entry.message.data(), msg_len);
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef FAUCET_JOB_JOURNAL_H
+#define FAUCET_JOB_JOURNAL_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "record_journal.h"
+
+enum class JobState : uint8_t { Queued = 1, Sending, Sent, Failed };
+
+/**
+ * The `RecordJournal` of the state changes of the payout jobs, the last record of a job wins on replay. It is
+ * compacted by `Rewrite` instead of being rotated.
+ */
+class JobJournal {
+public:
+    static const std::size_t ADDR_MAX_LEN = 111;
+
+    /// The txid or the error message, longer messages are cut
+    static const std::size_t MSG_MAX_LEN = 117;
+
+    struct Entry {
+        uint64_t id;
+        int64_t time;
+        JobState state;
+        std::string address;
+        std::string message;
+    };
+
+    using ReplayCallback = std::function<void(Entry const& entry)>;
+
+    /// Read all valid records from the journal file, returns the number of them
+    static std::size_t Replay(std::string const& path, ReplayCallback const& callback);
+
+    /**
+     * Replace the journal file atomically by one holding only `entries`, they cover the first `num_covered` appended
+     * records and the later ones go to the new file, see `RecordJournal::Rewrite`
+     */
+    bool Rewrite(std::string const& path, std::vector<Entry> const& entries, uint64_t num_covered);
+
+    /// Buffer the record, it reaches the disk on next `Sync`
+    bool Append(Entry const& entry);
+
+    uint64_t NumAppended() const { return m_file.NumAppended(); }
+
+    bool Sync();
+
+private:
+    static const uint32_t MAGIC = 0x51444842;  // "BHDQ"
+
+    struct Record {
+        RecordJournal::Header header;
+        uint64_t id;
+        int64_t time;
+        uint8_t state;
+        uint8_t addr_len;
+        uint8_t msg_len;
+        char addr[ADDR_MAX_LEN];
+        char msg[MSG_MAX_LEN];
+    };
+    static_assert(sizeof(Record) == 256, "job record must be 256 bytes");
+
+    static bool MakeRecord(Entry const& entry, Record& out_record);
+
+private:
+    RecordJournal m_file{sizeof(Record), MAGIC};
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef FAUCET_JSON_FORMATTER_HPP
+#define FAUCET_JSON_FORMATTER_HPP
+
+#include <plog/Log.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+/**
+ * Formats a plog record as one JSON object per line for log shippers, e.g.
+ * {"time":"2024-05-01T08:00:00.123Z","severity":"INFO","tid":42,"func":"main","line":120,"message":"..."}
+ */
+class JsonFormatter {
+public:
+    static plog::util::nstring header() { return plog::util::nstring(); }
+
+    static plog::util::nstring format(plog::Record const& record) {
+        tm t;
+        plog::util::gmtime_s(&t, &record.getTime().time);
+        // sized for any value of the int fields, not only valid dates, so snprintf cannot truncate
+        char time_buf[96];
+        snprintf(time_buf, sizeof(time_buf), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", t.tm_year + 1900, t.tm_mon + 1,
+                t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec, static_cast<int>(record.getTime().millitm));
+        std::string line;
+        line.reserve(128);
+        line.append(R"({"time":")");
+        line.append(time_buf);
+        line.append(R"(","severity":")");
+        line.append(plog::severityToString(record.getSeverity()));
+        line.append(R"(","tid":)");
+        line.append(std::to_string(record.getTid()));
+        line.append(R"(,"func":)");
+        AppendString(line, record.getFunc());
+        line.append(R"(,"line":)");
+        line.append(std::to_string(record.getLine()));
+        line.append(R"(,"message":)");
+        AppendString(line, record.getMessage());
+        line.append("}\n");
+        return line;
+    }
+
+private:
+    static void AppendString(std::string& out, std::string_view str) {
+        out.push_back('"');
+        for (char ch : str) {
+            switch (ch) {
+                case '"':
+                    out.append("\\\"");
+                    break;
+                case '\\':
+                    out.append("\\\\");
+                    break;
+                case '\n':
+                    out.append("\\n");
+                    break;
+                case '\r':
+                    out.append("\\r");
+                    break;
+                case '\t':
+                    out.append("\\t");
+                    break;
+                default:
+                    if (static_cast<uint8_t>(ch) < 0x20) {
+                        char buf[8];
+                        snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(static_cast<uint8_t>(ch)));
+                        out.append(buf);
+                    } else {
+                        out.push_back(ch);
+                    }
+            }
+        }
+        out.push_back('"');
+    }
+};
+
+#endif
@@ -1,98 +1,124 @@
 #include <iostream>
-#include <fstream>
 #include <string>
 
 #include <cxxopts.hpp>
 
 #include <plog/Log.h>
-#include <plog/Initializers/ConsoleInitializer.h>
-#include <plog/Appenders/ConsoleAppender.h>
+#include <plog/Init.h>
 #include <plog/Formatters/TxtFormatter.h>
 
 #include <json/reader.h>
 #include <json/json.h>
 #include <json/value.h>
 
+#include <unistd.h>
+
+#include <charconv>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "address.h"
+#include "async_appender.hpp"
+#include "backend_prober.hpp"
+#include "faucet_addr_man.h"
 #include "faucet_service.hpp"
+#include "job_executor.hpp"
+#include "json_formatter.hpp"
+#include "metrics.hpp"
+#include "payout_batcher.h"
+#include "payout_flights.hpp"
+#include "payout_jobs.h"
+#include "request_scanner.hpp"
 #include "rpc_client.h"
+#include "utxo_pool.h"
 
-class FaucetAddrMan {
-public:
-    bool SaveToFile(std::string const& path) {
-        Json::Value root(Json::arrayValue);
-        for (auto i = std::begin(m_records); i != std::end(m_records); ++i) {
-            Json::Value r;
-            r["address"] = i->first;
-            r["time"] = i->second;
-            root.append(r);
-        }
-        // open file
-        std::ofstream out(path);
-        if (!out.is_open()) {
-            PLOG_ERROR << "cannot open file to write: " << path;
-            return false;
-        }
-        out << root.toStyledString();
-        return true;
-    }
+namespace {
 
-    bool LoadFromFile(std::string const& path) {
-        std::ifstream in(path);
-        if (!in.is_open()) {
-            PLOG_ERROR << "cannot open file to read: " << path;
-            return false;
-        }
-        // length
-        in.seekg(0, std::ifstream::end);
-        int len = in.tellg();
-        in.seekg(0);
-        std::shared_ptr<char> json_str(new char[len + 1], [](char* p) { delete[] p; });
-        in.read(json_str.get(), len);
-        json_str.get()[len] = '\0';
-        // parse to json
-        Json::CharReaderBuilder builder;
-        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-        Json::Value root;
-        std::string errs;
-        if (!reader->parse(json_str.get(), json_str.get() + len, &root, &errs)) {
-            // cannot parse the json by the content of file
-            return false;
-        }
-        if (!root.isArray()) {
-            return false;
-        }
-        m_records.clear();
-        for (auto const& record : root) {
-            if (!record.isMember("address") || !record["address"].isString()) {
-                continue;
-            }
-            if (!record.isMember("time") || !record["time"].isInt()) {
-                continue;
-            }
-            std::string address_str = record["address"].asString();
-            int time = record["time"].asInt();
-            m_records[address_str] = time;
-        }
-        PLOG_DEBUG << "read total " << m_records.size() << " record(s) from db file";
+/**
+ * Read the string member `address` of the request body, the body is only parsed by jsoncpp when the scanner cannot
+ * decide on its own
+ *
+ * @return false when the body is not json
+ */
+bool ExtractAddress(std::string_view body, std::string& out_address, bool& out_found) {
+    auto res = RequestScanner::ScanAddress(body, out_address);
+    if (res != RequestScanner::Result::Fallback) {
+        out_found = res == RequestScanner::Result::Found;
         return true;
     }
+    thread_local std::unique_ptr<Json::CharReader> reader(Json::CharReaderBuilder().newCharReader());
+    Json::Value root;
+    std::string errs;
+    if (!reader->parse(body.data(), body.data() + body.size(), &root, &errs)) {
+        return false;
+    }
+    // `isMember` and `asString` throw on the other types
+    out_found = root.isObject() && root["address"].isString();
+    if (out_found) {
+        out_address = root["address"].asString();
+    }
+    return true;
+}
 
-    void Update(std::string const& addr) {
-        auto curr = time(nullptr);
-        m_records[addr] = curr;
+/**
+ * Parse `URL[=COOKIE_PATH]` of `--rpc-backend`, the credentials are taken from the `user:password@` of the url, then
+ * from the cookie and at last from `default_cookie_path`
+ */
+RPCClient::Backend ParseBackend(std::string const& spec, std::string const& default_cookie_path) {
+    std::string url = spec;
+    std::string cookie_path = default_cookie_path;
+    auto eq_pos = spec.find('=');
+    if (eq_pos != std::string::npos) {
+        url = spec.substr(0, eq_pos);
+        cookie_path = ExpandEnvPath(spec.substr(eq_pos + 1));
+    }
+    auto scheme_pos = url.find("://");
+    std::size_t host_pos = scheme_pos == std::string::npos ? 0 : scheme_pos + 3;
+    auto at_pos = url.find('@', host_pos);
+    if (at_pos != std::string::npos && at_pos < url.find('/', host_pos)) {
+        std::string user_info = url.substr(host_pos, at_pos - host_pos);
+        url.erase(host_pos, at_pos + 1 - host_pos);
+        auto colon_pos = user_info.find(':');
+        std::string passwd = colon_pos == std::string::npos ? "" : user_info.substr(colon_pos + 1);
+        return RPCClient::Backend{std::move(url), user_info.substr(0, colon_pos), std::move(passwd)};
     }
+    return RPCClient::MakeCookieBackend(std::move(url), cookie_path);
+}
 
-    int Query(std::string const& addr) {
-        auto i = m_records.find(addr);
-        if (i == std::end(m_records)) {
-            return 0;
-        }
-        return i->second;
+std::string_view const STATUS_PREFIX = "/status/";
+
+/// The default db of the versions which stored it as json
+char const* const LEGACY_DB_PATH = "faucet-db.json";
+
+bool StartsWith(std::string_view str, std::string_view prefix) { return str.substr(0, prefix.size()) == prefix; }
+
+/// Write the state of the job as json, returns the http status
+int RenderJobStatus(PayoutJobs const& jobs, std::string_view id_str, std::string& out_content) {
+    uint64_t id{0};
+    auto res = std::from_chars(id_str.data(), id_str.data() + id_str.size(), id);
+    PayoutJobs::Job job;
+    if (res.ec != std::errc() || res.ptr != id_str.data() + id_str.size() || !jobs.Query(id, job)) {
+        out_content = R"({"error":"no such job"})";
+        return 404;
     }
+    Json::Value root;
+    root["id"] = std::to_string(job.id);
+    root["status"] = PayoutJobs::StateToString(job.state);
+    root["address"] = job.address;
+    if (job.state == JobState::Sent) {
+        root["txid"] = job.txid_or_err;
+    } else if (job.state == JobState::Failed) {
+        root["error"] = job.txid_or_err;
+    }
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+    out_content = Json::writeString(writer, root);
+    return 200;
+}
 
-private:
-    std::map<std::string, int> m_records;
-};
+}  // namespace
 
 int main(int argc, char const* argv[]) {
     cxxopts::Options opts(
@@ -103,116 +129,388 @@ int main(int argc, char const* argv[]) {
              cxxopts::value<std::string>()->default_value("http://127.0.0.1:18732"))  // --rpc-url
             ("cookie-path", "The path to `.cookie`",
              cxxopts::value<std::string>()->default_value("$HOME/.btchd/testnet3/.cookie"))  // --cookie-path
+            ("rpc-backend",
+             "A btchd node as `URL[=COOKIE_PATH]`, the url can carry `user:password@`, repeat it for more nodes and "
+             "`--rpc-url` is ignored",
+             cxxopts::value<std::vector<std::string>>())  // --rpc-backend
+            ("rpc-probe-secs", "How often the health of the btchd nodes is checked, 0 disables the checks",
+             cxxopts::value<int>()->default_value("10"))  // --rpc-probe-secs
             ("addr", "Service will bind to this address",
              cxxopts::value<std::string>()->default_value("0.0.0.0"))  // --addr
             ("port", "Service will bind to this port",
              cxxopts::value<unsigned short>()->default_value("18080"))  // --port
             ("verbose", "Show more logs for debugging purpose")         // --verbose
+            ("verbose-curl",
+             "Let curl print its traffic to btchd on stderr, bypassing the log queue")  // --verbose-curl
+            ("log-format", "The format of the log lines, `txt` or `json`",
+             cxxopts::value<std::string>()->default_value("txt"))  // --log-format
+            ("log-queue-size", "How many log lines can wait to be written",
+             cxxopts::value<int>()->default_value("8192"))  // --log-queue-size
+            ("log-block", "Wait for room when the log queue is full instead of dropping the line")  // --log-block
             ("amount", "How many BHD we should send to user on each request",
              cxxopts::value<int>()->default_value("10"))  // --amount
             ("db-path", "The database file stores all funded addresses",
-             cxxopts::value<std::string>()->default_value("faucet-db.json"))  // --db
+             cxxopts::value<std::string>()->default_value("faucet-db.bin"))  // --db
+            ("import-json", "Import funded addresses from a json file into the database",
+             cxxopts::value<std::string>()->default_value(""))  // --import-json
+            ("export-json", "Export all funded addresses from the database to a json file and exit",
+             cxxopts::value<std::string>()->default_value(""))  // --export-json
             ("secs-on-next-fund", "How many seconds should be taken for the same address can be funded again?",
              cxxopts::value<int>()->default_value("60"))  // --secs-on-next-fund
+            ("db-sync-ms", "How often the journal of funded addresses is synced to disk",
+             cxxopts::value<int>()->default_value("1000"))  // --db-sync-ms
+            ("db-compact-secs", "How often the journal is compacted into the database file",
+             cxxopts::value<int>()->default_value("600"))  // --db-compact-secs
+            ("max-requests-per-conn", "How many requests can be served on one keep-alive connection",
+             cxxopts::value<int>()->default_value("100"))  // --max-requests-per-conn
+            ("max-sessions", "New connections are shed once this many are open, 0 disables the limit",
+             cxxopts::value<int>()->default_value("10000"))  // --max-sessions
+            ("header-timeout-secs", "How long the headers of a request can take to arrive, 0 disables the timeout",
+             cxxopts::value<int>()->default_value("10"))  // --header-timeout-secs
+            ("body-timeout-secs", "How long the body of a request can take to arrive, 0 disables the timeout",
+             cxxopts::value<int>()->default_value("30"))  // --body-timeout-secs
+            ("idle-timeout-secs", "How long a keep-alive connection can wait for the next request, 0 disables it",
+             cxxopts::value<int>()->default_value("15"))  // --idle-timeout-secs
+            ("response-timeout-secs",
+             "How long a request can wait for its response before the connection is closed, 0 disables the timeout",
+             cxxopts::value<int>()->default_value("60"))  // --response-timeout-secs
+            ("threads", "How many threads are used to run the service",
+             cxxopts::value<int>()->default_value("1"))  // --threads
+            ("rate-limit", "How many requests per second a client network can send, 0 disables the limit",
+             cxxopts::value<double>()->default_value("0"))  // --rate-limit
+            ("rate-burst", "How many requests a client network can send in a burst",
+             cxxopts::value<double>()->default_value("10"))  // --rate-burst
+            ("rate-ipv4-prefix", "IPv4 clients within this prefix length share one rate limit",
+             cxxopts::value<int>()->default_value("32"))  // --rate-ipv4-prefix
+            ("rate-ipv6-prefix", "IPv6 clients within this prefix length share one rate limit",
+             cxxopts::value<int>()->default_value("64"))  // --rate-ipv6-prefix
+            ("rpc-threads", "How many threads are used to invoke wallet RPC",
+             cxxopts::value<int>()->default_value("4"))  // --rpc-threads
+            ("batch-size", "How many addresses can be paid by one `sendmany` transaction",
+             cxxopts::value<int>()->default_value("1"))  // --batch-size
+            ("batch-window-ms", "How long an address waits in the queue for the other addresses of its batch",
+             cxxopts::value<int>()->default_value("0"))  // --batch-window-ms
+            ("utxo-pool-size", "How many payout-sized coins are kept in the wallet, 0 lets the wallet select the coins",
+             cxxopts::value<int>()->default_value("0"))  // --utxo-pool-size
+            ("utxo-fee", "The fee in BHD paid by each coin of the pool",
+             cxxopts::value<double>()->default_value("0.0001"))  // --utxo-fee
+            ("utxo-refill-secs", "How often the pool is checked and refilled",
+             cxxopts::value<int>()->default_value("30"))  // --utxo-refill-secs
+            ("job-mode",
+             "Answer a payout request with 202 and a job id at once, the job is paid later and its state is served "
+             "by `GET /status/<id>`")  // --job-mode
+            ("job-rate", "How many payout jobs are paid per second, it must be greater than 0",
+             cxxopts::value<double>()->default_value("10"))  // --job-rate
+            ("job-queue-size", "How many payout jobs can wait in the queue, the requests beyond it get 503",
+             cxxopts::value<int>()->default_value("10000"))  // --job-queue-size
+            ("job-retention-secs", "How long the state of a finished payout job can be queried",
+             cxxopts::value<int>()->default_value("3600"))  // --job-retention-secs
             ;
     auto result = opts.parse(argc, argv);
     if (result.count("help")) {
         std::cout << opts.help() << std::endl;
         return 0;
     }
+    // no job would ever be taken from the queue
+    if (!(result["job-rate"].as<double>() > 0)) {
+        std::cerr << "`--job-rate` must be greater than 0" << std::endl;
+        return 1;
+    }
     auto log_type = result.count("verbose") ? plog::Severity::debug : plog::Severity::info;
-    // Initialize log system
-    plog::ConsoleAppender<plog::TxtFormatter> appender;
-    plog::init(log_type, &appender);
+    // Initialize log system, the lines are written to stdout by a background thread
+    auto log_queue_size = static_cast<std::size_t>(std::max(1, result["log-queue-size"].as<int>()));
+    auto log_policy = result.count("log-block") ? LogFullPolicy::Block : LogFullPolicy::Drop;
+    std::unique_ptr<plog::IAppender> appender;
+    std::string log_format = result["log-format"].as<std::string>();
+    if (log_format == "json") {
+        appender = std::make_unique<AsyncAppender<JsonFormatter>>(log_queue_size, log_policy);
+    } else if (log_format == "txt") {
+        appender = std::make_unique<AsyncAppender<plog::TxtFormatter>>(log_queue_size, log_policy);
+    } else {
+        std::cerr << "Unknown log format `" << log_format << "`" << std::endl;
+        return 1;
+    }
+    plog::init(log_type, appender.get());
     PLOG_INFO << "Faucet for BitcoinHD testnet3";
 
-    std::string rpc_url = result["rpc-url"].as<std::string>();
+    // curl must be initialized before any RPC worker thread is started
+    curl_global_init(CURL_GLOBAL_ALL);
+
     std::string cookie_path = ExpandEnvPath(result["cookie-path"].as<std::string>());
-    PLOG_DEBUG << "Construct RPC object with url: " << rpc_url << ", cookie: " << cookie_path;
-    RPCClient rpc(true, rpc_url, cookie_path);
+    std::vector<RPCClient::Backend> backends;
+    if (result.count("rpc-backend")) {
+        for (auto const& spec : result["rpc-backend"].as<std::vector<std::string>>()) {
+            backends.push_back(ParseBackend(spec, cookie_path));
+        }
+    } else {
+        backends.push_back(RPCClient::MakeCookieBackend(result["rpc-url"].as<std::string>(), cookie_path));
+    }
+    for (auto const& backend : backends) {
+        PLOG_INFO << "RPC backend " << backend.url << " with user `" << backend.user << "`";
+    }
+    bool verbose_curl = result.count("verbose-curl") > 0;
+    RPCClient rpc(true, backends);
+    rpc.SetCurlVerbose(verbose_curl);
 
     int amount = result["amount"].as<int>();
+    int rpc_threads = result["rpc-threads"].as<int>();
 
     std::string addr = result["addr"].as<std::string>();
     unsigned short port = result["port"].as<unsigned short>();
 
-    FaucetAddrMan addr_man;
+    int secs_on_next_fund = result["secs-on-next-fund"].as<int>();
+
+    FaucetAddrMan addr_man(std::chrono::seconds{secs_on_next_fund});
     std::string db_path = ExpandEnvPath(result["db-path"].as<std::string>());
-    addr_man.LoadFromFile(db_path);
+    if (!addr_man.Open(db_path, std::chrono::milliseconds(result["db-sync-ms"].as<int>()),
+                std::chrono::seconds(result["db-compact-secs"].as<int>()))) {
+        PLOG_ERROR << "Cannot open the journal of db file: " << db_path;
+        return 1;
+    }
+    std::string import_path = ExpandEnvPath(result["import-json"].as<std::string>());
+    // the json db of the older version is picked up when the default db is used for the first time
+    if (import_path.empty() && !result.count("db-path") && access(db_path.c_str(), F_OK) != 0 &&
+            access(LEGACY_DB_PATH, F_OK) == 0) {
+        PLOG_INFO << "Found the json db of the older version, import it: " << LEGACY_DB_PATH;
+        import_path = LEGACY_DB_PATH;
+    }
+    if (!import_path.empty()) {
+        if (!addr_man.LoadFromFile(import_path)) {
+            PLOG_ERROR << "Cannot import json file: " << import_path;
+            return 1;
+        }
+        PLOG_INFO << "Imported json file " << import_path << ", total " << addr_man.ArchiveSize() << " record(s)";
+    }
+    std::string export_path = ExpandEnvPath(result["export-json"].as<std::string>());
+    if (!export_path.empty()) {
+        if (!addr_man.SaveToFile(export_path)) {
+            PLOG_ERROR << "Cannot export json file: " << export_path;
+            return 1;
+        }
+        PLOG_INFO << "Exported all records to " << export_path;
+        return 0;
+    }
 
-    int secs_on_next_fund = result["secs-on-next-fund"].as<int>();
+    ServiceOptions service_opts;
+    service_opts.max_requests_per_conn = result["max-requests-per-conn"].as<int>();
+    service_opts.max_sessions = result["max-sessions"].as<int>();
+    service_opts.header_timeout = std::chrono::seconds(result["header-timeout-secs"].as<int>());
+    service_opts.body_timeout = std::chrono::seconds(result["body-timeout-secs"].as<int>());
+    service_opts.idle_timeout = std::chrono::seconds(result["idle-timeout-secs"].as<int>());
+    service_opts.response_timeout = std::chrono::seconds(result["response-timeout-secs"].as<int>());
+    service_opts.rate_limit.rate = result["rate-limit"].as<double>();
+    service_opts.rate_limit.burst = result["rate-burst"].as<double>();
+    service_opts.rate_limit.ipv4_prefix = result["rate-ipv4-prefix"].as<int>();
+    service_opts.rate_limit.ipv6_prefix = result["rate-ipv6-prefix"].as<int>();
 
     PLOG_INFO << "Initializing service, bind " << addr << ", port " << port;
     tcp::endpoint endpoint(asio::ip::address::from_string(addr), port);
 
     asio::io_context ioc;
+    asio::thread_pool rpc_pool(rpc_threads);
+    std::unique_ptr<BackendProber> prober;
+    int probe_secs = result["rpc-probe-secs"].as<int>();
+    // a single node has nothing to fail over to, its health would only be written and never read
+    if (probe_secs > 0 && rpc.NumBackends() > 1) {
+        prober = std::make_unique<BackendProber>(ioc, rpc_pool, rpc, std::chrono::seconds(probe_secs));
+        prober->Start();
+    }
+    std::unique_ptr<RPCClient> pool_rpc;
+    std::unique_ptr<UtxoPool> utxo_pool;
+    int utxo_pool_size = result["utxo-pool-size"].as<int>();
+    if (utxo_pool_size > 0) {
+        UtxoPool::Options pool_opts;
+        pool_opts.target_size = utxo_pool_size;
+        pool_opts.coin_value =
+                amount * RPCClient::COIN + std::llround(result["utxo-fee"].as<double>() * RPCClient::COIN);
+        pool_opts.refill_interval = std::chrono::seconds(std::max(1, result["utxo-refill-secs"].as<int>()));
+        PLOG_INFO << "Keeping " << utxo_pool_size << " coin(s) of " << RPCClient::FormatAmount(pool_opts.coin_value)
+                  << "BHD for the payouts";
+        // the coins of the pool belong to the wallet of the first node, so the pool never routes to the others
+        RPCClient* utxo_rpc = &rpc;
+        if (rpc.NumBackends() > 1) {
+            pool_rpc = std::make_unique<RPCClient>(true, std::vector<RPCClient::Backend>{backends.front()});
+            pool_rpc->SetCurlVerbose(verbose_curl);
+            utxo_rpc = pool_rpc.get();
+        }
+        utxo_pool = std::make_unique<UtxoPool>(ioc, rpc_pool, *utxo_rpc, pool_opts);
+        utxo_pool->Start();
+    }
+    PayoutBatcher batcher(
+            ioc, rpc_pool, rpc, utxo_pool.get(), amount, result["batch-size"].as<int>(),
+            std::chrono::milliseconds(result["batch-window-ms"].as<int>()),
+            [&addr_man](std::vector<std::string> const& addresses, std::string const&) {
+                // only journaled here, the db file is rewritten by the background compaction
+                for (auto const& address : addresses) {
+                    addr_man.Update(address);
+                }
+            });
+    auto check_cooldown = [&addr_man, secs_on_next_fund](std::string const& address, std::string& out_msg) {
+        int64_t fund_time = addr_man.Query(address);
+        if (fund_time == 0) {
+            return false;
+        }
+        int64_t secs = time(nullptr) - fund_time;
+        if (secs >= secs_on_next_fund) {
+            return false;
+        }
+        std::stringstream ss;
+        ss << "Address " << address << " already funded " << secs << " seconds ago";
+        out_msg = ss.str();
+        return true;
+    };
+    std::unique_ptr<PayoutJobs> jobs;
+    std::unique_ptr<JobExecutor> job_executor;
+    if (result.count("job-mode")) {
+        jobs = std::make_unique<PayoutJobs>(std::max(1, result["job-queue-size"].as<int>()),
+                std::chrono::seconds(result["job-retention-secs"].as<int>()), check_cooldown);
+        std::string jobs_path = db_path + ".jobs";
+        // an interrupted payout is taken as made, so the address is not paid twice by a new request
+        if (!jobs->Open(jobs_path, std::chrono::milliseconds(result["db-sync-ms"].as<int>()),
+                    std::chrono::seconds(result["db-compact-secs"].as<int>()),
+                    [&addr_man](std::string const& address) { addr_man.Update(address); })) {
+            PLOG_ERROR << "Cannot open the journal of payout jobs: " << jobs_path;
+            return 1;
+        }
+        double job_rate = result["job-rate"].as<double>();
+        PLOG_INFO << "Payouts are queued as jobs and paid at " << job_rate << " job(s) per second";
+        // enough jobs in flight to keep every RPC thread busy with full batches
+        job_executor = std::make_unique<JobExecutor>(
+                ioc, rpc_pool, *jobs, batcher, job_rate, rpc_threads * std::max(1, result["batch-size"].as<int>()));
+        job_executor->Start();
+    }
+    PayoutFlights payouts(
+            check_cooldown, [&batcher, amount](std::string const& address, PayoutFlights::PayCallback callback) {
+                // queue the address, the batch is paid on the worker pool and the io thread keeps serving
+                PLOG_INFO << "Distribute fund " << amount << "BHD to address `" << address << "`";
+                batcher.Submit(address, std::move(callback));
+            });
     Service service(
             ioc, endpoint,
-            [&rpc, amount, &addr_man, &db_path, secs_on_next_fund](
-                    Session* psession, SimpleHttpMessageParser const& parser) {
+            [&payouts, &check_cooldown, &jobs](
+                    std::shared_ptr<Session> const& psession, SimpleHttpMessageParser const& parser) {
                 PLOG_DEBUG << "Processing message...";
                 // analyze the received string and trying to return the tx id
-                SimpleHttpMessageBuilder msg_builder;
-                std::string content_type;
+                SimpleHttpMessageBuilder msg_builder(psession->KeepAlive());
+                if (jobs && parser.ReadMethodType() == "GET" && StartsWith(parser.ReadTarget(), STATUS_PREFIX)) {
+                    std::string content;
+                    int status = RenderJobStatus(*jobs, parser.ReadTarget().substr(STATUS_PREFIX.size()), content);
+                    msg_builder.WriteContent(std::move(content), "application/json", status);
+                    psession->Write(msg_builder.TakeMessage());
+                    return;
+                }
+                std::string_view content_type;
                 if (!parser.ReadHeader("Content-Type", content_type)) {
+                    GetMetrics().Inc(Metrics::Outcome::NoContentType);
                     PLOG_ERROR << "Message is received without `Content-Type`, ignored.";
-                    msg_builder.WriteContent("Missing `Content-Type`.", "text/html");
-                    psession->Write(msg_builder.GetMessage());
+                    msg_builder.WriteStaticContent("Missing `Content-Type`.", "text/html");
+                    psession->Write(msg_builder.TakeMessage());
                     return;
                 }
                 if (content_type != "application/json") {
+                    GetMetrics().Inc(Metrics::Outcome::InvalidContentType);
                     PLOG_ERROR << "Message is received with an invalid `Content-Type`: " << content_type;
-                    msg_builder.WriteContent("Invalid Content-Type, `application/json` is required.", "text/html");
-                    psession->Write(msg_builder.GetMessage());
+                    msg_builder.WriteStaticContent("Invalid Content-Type, `application/json` is required.", "text/html");
+                    psession->Write(msg_builder.TakeMessage());
                     return;
                 }
-                // parse the json from content
-                Json::CharReaderBuilder builder;
-                Json::CharReader* reader = builder.newCharReader();
-                std::string body = parser.ReadBody();
-                Json::Value root;
-                std::string errs;
-                if (!reader->parse(body.c_str(), body.c_str() + body.size(), &root, &errs)) {
+                // read the address from content
+                std::string address;
+                bool found{false};
+                bool parsed;
+                {
+                    StageTimer timer(Metrics::Stage::Json);
+                    parsed = ExtractAddress(parser.ReadBody(), address, found);
+                }
+                if (!parsed) {
+                    GetMetrics().Inc(Metrics::Outcome::BadJson);
                     PLOG_ERROR << "Cannot parse json from the message.";
-                    msg_builder.WriteContent("Cannot parse json!", "text/html");
-                    psession->Write(msg_builder.GetMessage());
+                    msg_builder.WriteStaticContent("Cannot parse json!", "text/html");
+                    psession->Write(msg_builder.TakeMessage());
                     return;
                 }
-                if (!root.isMember("address")) {
+                if (!found) {
+                    GetMetrics().Inc(Metrics::Outcome::NoAddress);
                     PLOG_ERROR << "No `address` can be found.";
-                    msg_builder.WriteContent("No `address` can be found!", "text/html");
-                    psession->Write(msg_builder.GetMessage());
+                    msg_builder.WriteStaticContent("No `address` can be found!", "text/html");
+                    psession->Write(msg_builder.TakeMessage());
                     return;
                 }
-                std::string address = root["address"].asString();
-                // check before invoke RPC
-                int fund_time = addr_man.Query(address);
-                if (fund_time != 0) {
-                    int secs = time(nullptr) - fund_time;
-                    if (secs < secs_on_next_fund) {
-                        std::stringstream ss;
-                        ss << "Address " << address << " already funded " << secs << " seconds ago";
-                        PLOG_ERROR << ss.str();
-                        msg_builder.WriteContent(ss.str(), "text/html");
-                        psession->Write(msg_builder.GetMessage());
+                // wrong-network and mistyped addresses never reach the wallet
+                AddressType address_type = ValidateAddress(address, AddressParams::Testnet3());
+                if (address_type == AddressType::Invalid) {
+                    GetMetrics().Inc(Metrics::Outcome::InvalidAddress);
+                    PLOG_ERROR << "Invalid address `" << address << "`";
+                    msg_builder.WriteStaticContent("Invalid testnet3 address!", "text/html");
+                    psession->Write(msg_builder.TakeMessage());
+                    return;
+                }
+                // the cooldown and the payout use one spelling of the address
+                NormalizeAddress(address, address_type);
+                // in job mode the request is answered once the job is queued, the journal is synced later by the
+                // background thread of the jobs, so the job can be lost by a crash in `--db-sync-ms`
+                if (jobs) {
+                    // check before taking the lock of the jobs
+                    std::string cooldown_msg;
+                    bool cooling_down;
+                    {
+                        StageTimer timer(Metrics::Stage::Cooldown);
+                        cooling_down = check_cooldown(address, cooldown_msg);
+                    }
+                    if (cooling_down) {
+                        GetMetrics().Inc(Metrics::Outcome::Cooldown);
+                        PLOG_ERROR << cooldown_msg;
+                        msg_builder.WriteContent(std::move(cooldown_msg), "text/html");
+                        psession->Write(msg_builder.TakeMessage());
                         return;
                     }
-                }
-                // invoke RPC and send the amount
-                PLOG_INFO << "Distribute fund " << amount << "BHD to address `" << address << "`";
-                try {
-                    std::string tx_str = rpc.SendToAddress(address, amount);
-                    addr_man.Update(address);
-                    PLOG_INFO << "tx=" << tx_str;
-                    if (!addr_man.SaveToFile(db_path)) {
-                        PLOG_ERROR << "Cannot write db file: " << db_path;
+                    uint64_t id;
+                    auto res = jobs->Submit(address, id, cooldown_msg);
+                    if (res == PayoutJobs::SubmitResult::Cooldown) {
+                        // the previous job is finished between the check and the submit
+                        GetMetrics().Inc(Metrics::Outcome::Cooldown);
+                        PLOG_ERROR << cooldown_msg;
+                        msg_builder.WriteContent(std::move(cooldown_msg), "text/html");
+                        psession->Write(msg_builder.TakeMessage());
+                        return;
+                    }
+                    if (res == PayoutJobs::SubmitResult::Full) {
+                        GetMetrics().Inc(Metrics::Outcome::QueueFull);
+                        PLOG_ERROR << "The payout queue is full, address `" << address << "` is rejected";
+                        msg_builder.WriteStaticContent("The payout queue is full.", "text/html", 503);
+                        psession->Write(msg_builder.TakeMessage());
+                        return;
                     }
-                    msg_builder.WriteContent(tx_str, "text/html");
-                } catch (std::exception const& e) {
-                    msg_builder.WriteContent(e.what(), "text/html");
+                    GetMetrics().Inc(Metrics::Outcome::Queued);
+                    PLOG_INFO << "Payout job " << id << " of address `" << address << "` is "
+                              << (res == PayoutJobs::SubmitResult::Queued ? "queued" : "already queued");
+                    msg_builder.WriteContent(
+                            R"({"id":")" + std::to_string(id) + R"(","status":"queued"})", "application/json", 202);
+                    psession->Write(msg_builder.TakeMessage());
+                    return;
                 }
-                psession->Write(msg_builder.GetMessage());
-            });
+                // concurrent requests of the same address share one payout
+                payouts.Request(address, [psession](Metrics::Outcome outcome, std::string const& content) {
+                    GetMetrics().Inc(outcome);
+                    // the response is written back on the session's strand
+                    SimpleHttpMessageBuilder msg_builder(psession->KeepAlive());
+                    msg_builder.WriteContent(content, "text/html");
+                    psession->Write(msg_builder.TakeMessage());
+                });
+            },
+            service_opts);
+    // the io_context is run by `--threads` threads, each session is bound to its own strand
+    int num_threads = std::max(1, result["threads"].as<int>());
+    PLOG_INFO << "Running service with " << num_threads << " thread(s)";
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; ++i) {
+        threads.emplace_back([&ioc]() { ioc.run(); });
+    }
     ioc.run();
+    for (auto& t : threads) {
+        t.join();
+    }
+    rpc_pool.join();
+    curl_global_cleanup();
     return 0;
 }
@@ -0,0 +1,179 @@
+#ifndef FAUCET_METRICS_HPP
+#define FAUCET_METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+/**
+ * Counters, gauges and latency histograms exposed in the Prometheus text format. Every thread updates its own
+ * cache-line aligned block with relaxed atomics, the blocks are only summed up when the metrics are scraped.
+ */
+class Metrics {
+public:
+    enum class Outcome {
+        BadRequest,
+        Timeout,
+        Shed,
+        RateLimited,
+        NoContentType,
+        InvalidContentType,
+        BadJson,
+        NoAddress,
+        InvalidAddress,
+        Cooldown,
+        QueueFull,
+        RpcError,
+        Paid,
+        Queued,
+        Count
+    };
+
+    enum class Stage { Parse, Json, Cooldown, Rpc, DbSync, DbCompact, Write, Count };
+
+    enum class Gauge { OpenSessions, WriteQueueDepth, PayoutQueueDepth, Count };
+
+    enum class Counter { LogLinesDropped, JobsSent, JobsFailed, Count };
+
+    void Inc(Outcome outcome) { GetBlock().outcomes[Index(outcome)].fetch_add(1, std::memory_order_relaxed); }
+
+    void Inc(Counter counter) { GetBlock().counters[Index(counter)].fetch_add(1, std::memory_order_relaxed); }
+
+    void Observe(Stage stage, std::chrono::nanoseconds duration) {
+        auto& hist = GetBlock().stages[Index(stage)];
+        uint64_t ns = duration.count() > 0 ? duration.count() : 0;
+        std::size_t b = 0;
+        while (b < NUM_BUCKETS && ns > BUCKET_BOUNDS_NS[b]) {
+            ++b;
+        }
+        hist.buckets[b].fetch_add(1, std::memory_order_relaxed);
+        hist.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    void Add(Gauge gauge, int64_t delta) {
+        GetBlock().gauges[Index(gauge)].fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    std::string Render() const {
+        std::stringstream ss;
+        ss << "# HELP faucet_requests_total Requests handled by the faucet grouped by their outcome.\n";
+        ss << "# TYPE faucet_requests_total counter\n";
+        for (std::size_t i = 0; i < Index(Outcome::Count); ++i) {
+            uint64_t total{0};
+            for (auto const& block : m_blocks) {
+                total += block.outcomes[i].load(std::memory_order_relaxed);
+            }
+            ss << "faucet_requests_total{outcome=\"" << OUTCOME_NAMES[i] << "\"} " << total << "\n";
+        }
+        ss << "# HELP faucet_stage_duration_seconds Latency of each stage of the request pipeline.\n";
+        ss << "# TYPE faucet_stage_duration_seconds histogram\n";
+        for (std::size_t i = 0; i < Index(Stage::Count); ++i) {
+            std::array<uint64_t, NUM_BUCKETS + 1> buckets{};
+            uint64_t sum_ns{0};
+            for (auto const& block : m_blocks) {
+                for (std::size_t b = 0; b <= NUM_BUCKETS; ++b) {
+                    buckets[b] += block.stages[i].buckets[b].load(std::memory_order_relaxed);
+                }
+                sum_ns += block.stages[i].sum_ns.load(std::memory_order_relaxed);
+            }
+            uint64_t cumulative{0};
+            for (std::size_t b = 0; b < NUM_BUCKETS; ++b) {
+                cumulative += buckets[b];
+                ss << "faucet_stage_duration_seconds_bucket{stage=\"" << STAGE_NAMES[i] << "\",le=\""
+                   << BUCKET_BOUNDS_NS[b] / 1e9 << "\"} " << cumulative << "\n";
+            }
+            cumulative += buckets[NUM_BUCKETS];
+            ss << "faucet_stage_duration_seconds_bucket{stage=\"" << STAGE_NAMES[i] << "\",le=\"+Inf\"} " << cumulative
+               << "\n";
+            ss << "faucet_stage_duration_seconds_sum{stage=\"" << STAGE_NAMES[i] << "\"} " << sum_ns / 1e9 << "\n";
+            ss << "faucet_stage_duration_seconds_count{stage=\"" << STAGE_NAMES[i] << "\"} " << cumulative << "\n";
+        }
+        for (std::size_t i = 0; i < Index(Gauge::Count); ++i) {
+            int64_t total{0};
+            for (auto const& block : m_blocks) {
+                total += block.gauges[i].load(std::memory_order_relaxed);
+            }
+            ss << "# TYPE " << GAUGE_NAMES[i] << " gauge\n";
+            ss << GAUGE_NAMES[i] << " " << total << "\n";
+        }
+        for (std::size_t i = 0; i < Index(Counter::Count); ++i) {
+            uint64_t total{0};
+            for (auto const& block : m_blocks) {
+                total += block.counters[i].load(std::memory_order_relaxed);
+            }
+            ss << "# TYPE " << COUNTER_NAMES[i] << " counter\n";
+            ss << COUNTER_NAMES[i] << " " << total << "\n";
+        }
+        return ss.str();
+    }
+
+private:
+    static const std::size_t MAX_THREADS = 64;
+
+    static const std::size_t NUM_BUCKETS = 12;
+
+    static constexpr uint64_t BUCKET_BOUNDS_NS[NUM_BUCKETS] = {10'000,      50'000,      100'000,       500'000,
+                                                               1'000'000,   5'000'000,   10'000'000,    50'000'000,
+                                                               100'000'000, 500'000'000, 1'000'000'000, 5'000'000'000};
+
+    static constexpr char const* OUTCOME_NAMES[] = {"bad_request", "timeout", "shed", "rate_limited", "no_content_type",
+            "invalid_content_type", "bad_json", "no_address", "invalid_address", "cooldown", "queue_full", "rpc_error",
+            "paid", "queued"};
+
+    static constexpr char const* STAGE_NAMES[] = {"parse", "json", "cooldown", "rpc", "db_sync", "db_compact", "write"};
+
+    static constexpr char const* GAUGE_NAMES[] = {
+            "faucet_open_sessions", "faucet_write_queue_depth", "faucet_payout_queue_depth"};
+
+    static constexpr char const* COUNTER_NAMES[] = {
+            "faucet_log_lines_dropped_total", "faucet_payout_jobs_sent_total", "faucet_payout_jobs_failed_total"};
+
+    template <typename E>
+    static constexpr std::size_t Index(E e) {
+        return static_cast<std::size_t>(e);
+    }
+
+    struct Histogram {
+        std::array<std::atomic<uint64_t>, NUM_BUCKETS + 1> buckets{};
+        std::atomic<uint64_t> sum_ns{0};
+    };
+
+    struct alignas(64) Block {
+        std::array<std::atomic<uint64_t>, static_cast<std::size_t>(Outcome::Count)> outcomes{};
+        std::array<Histogram, static_cast<std::size_t>(Stage::Count)> stages{};
+        std::array<std::atomic<int64_t>, static_cast<std::size_t>(Gauge::Count)> gauges{};
+        std::array<std::atomic<uint64_t>, static_cast<std::size_t>(Counter::Count)> counters{};
+    };
+
+    /// Threads beyond `MAX_THREADS` share blocks, it is still correct since all updates are atomic
+    Block& GetBlock() {
+        static std::atomic<std::size_t> next_index{0};
+        thread_local std::size_t index = next_index.fetch_add(1, std::memory_order_relaxed) % MAX_THREADS;
+        return m_blocks[index];
+    }
+
+private:
+    std::array<Block, MAX_THREADS> m_blocks;
+};
+
+inline Metrics& GetMetrics() {
+    static Metrics metrics;
+    return metrics;
+}
+
+/// Observes the time from its construction to its destruction
+class StageTimer {
+public:
+    explicit StageTimer(Metrics::Stage stage) : m_stage(stage), m_start(std::chrono::steady_clock::now()) {}
+
+    ~StageTimer() { GetMetrics().Observe(m_stage, std::chrono::steady_clock::now() - m_start); }
+
+private:
+    Metrics::Stage m_stage;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "payout_batcher.h"
+
+#include <algorithm>
+
+#include <plog/Log.h>
+
+PayoutBatcher::PayoutBatcher(asio::io_context& ioc, asio::thread_pool& rpc_pool, RPCClient& rpc, UtxoPool* utxo_pool,
+        uint64_t amount, int batch_size, std::chrono::milliseconds window, PaidCallback paid_callback)
+        : m_strand(asio::make_strand(ioc)),
+          m_timer(m_strand),
+          m_rpc_pool(rpc_pool),
+          m_rpc(rpc),
+          m_utxo_pool(utxo_pool),
+          m_amount(amount),
+          m_batch_size(std::max(1, batch_size)),
+          m_window(window),
+          m_paid_callback(std::move(paid_callback)) {}
+
+void PayoutBatcher::Submit(std::string address, Callback callback) {
+    asio::post(m_strand, [this, address = std::move(address), callback = std::move(callback)]() mutable {
+        m_batch[std::move(address)].push_back(std::move(callback));
+        if (m_batch.size() >= m_batch_size || m_window.count() == 0) {
+            Flush();
+            return;
+        }
+        if (!m_timer_armed) {
+            m_timer_armed = true;
+            m_timer.expires_after(m_window);
+            m_timer.async_wait([this](std::error_code const& ec) {
+                if (ec == asio::error::operation_aborted) {
+                    return;
+                }
+                Flush();
+            });
+        }
+    });
+}
+
+void PayoutBatcher::Flush() {
+    if (m_timer_armed) {
+        m_timer_armed = false;
+        m_timer.cancel();
+    }
+    if (m_batch.empty()) {
+        return;
+    }
+    Batch batch;
+    batch.swap(m_batch);
+    asio::post(m_rpc_pool, [this, batch = std::move(batch)]() mutable { Pay(std::move(batch)); });
+}
+
+void PayoutBatcher::Pay(Batch batch) {
+    std::vector<std::string> addresses;
+    addresses.reserve(batch.size());
+    for (auto const& entry : batch) {
+        addresses.push_back(entry.first);
+    }
+    bool succ{false};
+    std::string content;
+    try {
+        bool paid_by_pool = m_utxo_pool && m_utxo_pool->Pay(addresses, m_amount * RPCClient::COIN, content);
+        // the wallet selects the coins itself when the pool has run out
+        if (!paid_by_pool && addresses.size() == 1) {
+            content = m_rpc.SendToAddress(addresses.front(), m_amount);
+        } else if (!paid_by_pool) {
+            std::map<std::string, uint64_t> amounts;
+            for (auto const& address : addresses) {
+                amounts[address] = m_amount;
+            }
+            content = m_rpc.SendMany(amounts);
+        }
+        succ = true;
+        PLOG_INFO << "tx=" << content << ", paid " << addresses.size() << " address(es)";
+    } catch (std::exception const& e) {
+        PLOG_ERROR << "Cannot pay " << addresses.size() << " address(es): " << e.what();
+        content = e.what();
+    }
+    if (succ) {
+        // the batch is paid whatever happens here, the requests must not be told otherwise
+        try {
+            m_paid_callback(addresses, content);
+        } catch (std::exception const& e) {
+            PLOG_ERROR << "Cannot record the payout of tx=" << content << ": " << e.what();
+        }
+    }
+    for (auto const& entry : batch) {
+        for (auto const& callback : entry.second) {
+            callback(succ, content);
+        }
+    }
+}
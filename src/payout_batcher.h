@@ -0,0 +1,56 @@
+#ifndef FAUCET_PAYOUT_BATCHER_H
+#define FAUCET_PAYOUT_BATCHER_H
+
+#include <asio.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "rpc_client.h"
+#include "utxo_pool.h"
+
+/**
+ * Collects the addresses which passed the cooldown check and pays them with one `sendmany` transaction when the
+ * batch reaches `batch_size` addresses or `window` is elapsed since the first address is queued
+ */
+class PayoutBatcher {
+public:
+    /// Invoked for every waiting request with the shared txid or the error message
+    using Callback = std::function<void(bool succ, std::string const& txid_or_err)>;
+
+    /// Invoked once per successful batch before the waiting requests are answered
+    using PaidCallback = std::function<void(std::vector<std::string> const& addresses, std::string const& txid)>;
+
+    /// The batches are paid from `utxo_pool` when it has enough coins, otherwise by the wallet, `utxo_pool` can be null
+    PayoutBatcher(asio::io_context& ioc, asio::thread_pool& rpc_pool, RPCClient& rpc, UtxoPool* utxo_pool,
+            uint64_t amount, int batch_size, std::chrono::milliseconds window, PaidCallback paid_callback);
+
+    /// Thread-safe, the same address queued more than once within a batch is only paid once
+    void Submit(std::string address, Callback callback);
+
+private:
+    using Batch = std::map<std::string, std::vector<Callback>>;
+
+    void Flush();
+
+    void Pay(Batch batch);
+
+private:
+    asio::strand<asio::io_context::executor_type> m_strand;
+    asio::steady_timer m_timer;
+    asio::thread_pool& m_rpc_pool;
+    RPCClient& m_rpc;
+    UtxoPool* m_utxo_pool;
+    uint64_t m_amount;
+    std::size_t m_batch_size;
+    std::chrono::milliseconds m_window;
+    PaidCallback m_paid_callback;
+    bool m_timer_armed{false};
+    Batch m_batch;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef FAUCET_PAYOUT_FLIGHTS_HPP
+#define FAUCET_PAYOUT_FLIGHTS_HPP
+
+#include <functional>
+#include <string>
+#include <utility>
+
+#include <plog/Log.h>
+
+#include "metrics.hpp"
+#include "single_flight.hpp"
+
+/**
+ * The payout path of a request when the jobs are off. The cooldown is checked, then the concurrent requests of one
+ * address join one flight whose leader checks the cooldown again and pays, every request is answered with the result.
+ */
+class PayoutFlights {
+public:
+    using Reply = std::function<void(Metrics::Outcome outcome, std::string const& content)>;
+
+    /// Returns true with the message when the address is cooling down
+    using CooldownCheck = std::function<bool(std::string const& address, std::string& out_msg)>;
+
+    using PayCallback = std::function<void(bool succ, std::string const& txid_or_err)>;
+
+    /// Pays the address, the paid address must be cooling down before `callback` is invoked
+    using Pay = std::function<void(std::string const& address, PayCallback callback)>;
+
+    PayoutFlights(CooldownCheck check_cooldown, Pay pay)
+        : m_check_cooldown(std::move(check_cooldown)), m_pay(std::move(pay)) {}
+
+    /// `reply` is invoked on the calling thread for a cooldown, or on the thread which finishes the payout
+    void Request(std::string const& address, Reply reply) {
+        std::string cooldown_msg;
+        bool cooling_down;
+        {
+            StageTimer timer(Metrics::Stage::Cooldown);
+            cooling_down = m_check_cooldown(address, cooldown_msg);
+        }
+        if (cooling_down) {
+            PLOG_ERROR << cooldown_msg;
+            reply(Metrics::Outcome::Cooldown, cooldown_msg);
+            return;
+        }
+        if (!m_flights.Join(address, std::move(reply))) {
+            PLOG_INFO << "Address `" << address << "` is attached to the payout in flight";
+            return;
+        }
+        // the previous flight might be finished between the check and the join, check it again
+        if (m_check_cooldown(address, cooldown_msg)) {
+            PLOG_ERROR << cooldown_msg;
+            m_flights.Complete(address, Metrics::Outcome::Cooldown, cooldown_msg);
+            return;
+        }
+        m_pay(address, [this, address](bool succ, std::string const& txid_or_err) {
+            m_flights.Complete(address, succ ? Metrics::Outcome::Paid : Metrics::Outcome::RpcError, txid_or_err);
+        });
+    }
+
+    /// How many addresses are being paid
+    std::size_t NumInFlight() const { return m_flights.Size(); }
+
+private:
+    CooldownCheck m_check_cooldown;
+    Pay m_pay;
+    // the records are updated before the flight is completed, so a finished flight is always seen by the check
+    SingleFlight<std::string, Metrics::Outcome, std::string> m_flights;
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "payout_jobs.h"
+
+#include <algorithm>
+#include <ctime>
+
+#include <plog/Log.h>
+
+#include "metrics.hpp"
+
+PayoutJobs::~PayoutJobs() {
+    if (m_bg_thread.joinable()) {
+        {
+            std::lock_guard lock(m_bg_mtx);
+            m_bg_stop = true;
+        }
+        m_bg_cv.notify_all();
+        m_bg_thread.join();
+    }
+}
+
+bool PayoutJobs::Open(std::string const& path, std::chrono::milliseconds sync_interval,
+        std::chrono::seconds compact_interval, InterruptedCallback const& on_interrupted) {
+    m_path = path;
+    {
+        std::lock_guard lock(m_mtx);
+        std::size_t num_records = JobJournal::Replay(m_path, [this](JobJournal::Entry const& entry) {
+            Job& job = m_jobs[entry.id];
+            job.id = entry.id;
+            job.state = entry.state;
+            job.address = entry.address;
+            job.txid_or_err = entry.message;
+            job.time = entry.time;
+        });
+        int64_t now = time(nullptr);
+        std::vector<uint64_t> queued;
+        std::vector<std::pair<int64_t, uint64_t>> finished;
+        for (auto i = std::begin(m_jobs); i != std::end(m_jobs);) {
+            Job& job = i->second;
+            if (job.state == JobState::Sending) {
+                PLOG_ERROR << "Payout job " << job.id << " of address `" << job.address
+                           << "` was interrupted while sending, it is failed since it might have been paid";
+                job.state = JobState::Failed;
+                job.txid_or_err = "interrupted while sending, the payout might have been made";
+                job.time = now;
+                on_interrupted(job.address);
+            }
+            if (job.state == JobState::Queued) {
+                queued.push_back(job.id);
+                m_active[job.address] = job.id;
+            } else if (now - job.time < m_retention) {
+                finished.emplace_back(job.time, job.id);
+            } else {
+                i = m_jobs.erase(i);
+                continue;
+            }
+            ++i;
+        }
+        std::sort(std::begin(queued), std::end(queued));
+        m_queue.assign(std::begin(queued), std::end(queued));
+        std::sort(std::begin(finished), std::end(finished));
+        m_finished.assign(std::begin(finished), std::end(finished));
+        GetMetrics().Add(Metrics::Gauge::PayoutQueueDepth, static_cast<int64_t>(m_queue.size()));
+        PLOG_INFO << "Replayed " << num_records << " record(s) of payout jobs, " << m_queue.size() << " job(s) queued";
+    }
+    if (!Compact()) {
+        return false;
+    }
+    m_bg_thread = std::thread(
+            [this, sync_interval, compact_interval]() { BackgroundLoop(sync_interval, compact_interval); });
+    return true;
+}
+
+PayoutJobs::SubmitResult PayoutJobs::Submit(
+        std::string const& address, uint64_t& out_id, std::string& out_cooldown_msg) {
+    std::lock_guard lock(m_mtx);
+    auto active = m_active.find(address);
+    if (active != std::end(m_active)) {
+        out_id = active->second;
+        return SubmitResult::Existing;
+    }
+    // the paid addresses are recorded before their jobs are finished
+    if (m_check_cooldown(address, out_cooldown_msg)) {
+        return SubmitResult::Cooldown;
+    }
+    if (m_queue.size() >= m_max_queued) {
+        return SubmitResult::Full;
+    }
+    uint64_t id = NewId();
+    Job& job = m_jobs[id];
+    job.id = id;
+    job.address = address;
+    SetState(job, JobState::Queued, std::string());
+    m_queue.push_back(id);
+    m_active[address] = id;
+    GetMetrics().Add(Metrics::Gauge::PayoutQueueDepth, 1);
+    out_id = id;
+    return SubmitResult::Queued;
+}
+
+bool PayoutJobs::Query(uint64_t id, Job& out_job) const {
+    std::lock_guard lock(m_mtx);
+    auto i = m_jobs.find(id);
+    if (i == std::end(m_jobs)) {
+        return false;
+    }
+    out_job = i->second;
+    return true;
+}
+
+std::vector<PayoutJobs::Job> PayoutJobs::Take(std::size_t max_num) {
+    std::vector<Job> jobs;
+    {
+        std::lock_guard lock(m_mtx);
+        while (jobs.size() < max_num && !m_queue.empty()) {
+            Job& job = m_jobs[m_queue.front()];
+            m_queue.pop_front();
+            SetState(job, JobState::Sending, std::string());
+            jobs.push_back(job);
+        }
+    }
+    if (jobs.empty()) {
+        return jobs;
+    }
+    GetMetrics().Add(Metrics::Gauge::PayoutQueueDepth, -static_cast<int64_t>(jobs.size()));
+    StageTimer timer(Metrics::Stage::DbSync);
+    if (!SyncJournal()) {
+        // paying them anyway could pay twice after a restart
+        PLOG_ERROR << "cannot sync the payout jobs, " << jobs.size() << " job(s) are failed";
+        for (auto const& job : jobs) {
+            Finish(job.id, false, "cannot journal the job");
+        }
+        jobs.clear();
+    }
+    return jobs;
+}
+
+void PayoutJobs::Finish(uint64_t id, bool succ, std::string const& txid_or_err) {
+    std::lock_guard lock(m_mtx);
+    auto i = m_jobs.find(id);
+    if (i == std::end(m_jobs)) {
+        return;
+    }
+    Job& job = i->second;
+    SetState(job, succ ? JobState::Sent : JobState::Failed, txid_or_err);
+    m_active.erase(job.address);
+    m_finished.emplace_back(job.time, job.id);
+}
+
+std::size_t PayoutJobs::QueueSize() const {
+    std::lock_guard lock(m_mtx);
+    return m_queue.size();
+}
+
+char const* PayoutJobs::StateToString(JobState state) {
+    switch (state) {
+        case JobState::Queued:
+        case JobState::Sending:
+            // a sending job is not paid yet as far as the client can tell
+            return "queued";
+        case JobState::Sent:
+            return "sent";
+        case JobState::Failed:
+            return "failed";
+    }
+    return "unknown";
+}
+
+void PayoutJobs::SetState(Job& job, JobState state, std::string txid_or_err) {
+    job.state = state;
+    job.txid_or_err = std::move(txid_or_err);
+    job.time = time(nullptr);
+    m_journal.Append({job.id, job.time, job.state, job.address, job.txid_or_err});
+}
+
+uint64_t PayoutJobs::NewId() {
+    while (true) {
+        uint64_t id = (static_cast<uint64_t>(m_random()) << 32) | m_random();
+        if (id != 0 && m_jobs.find(id) == std::end(m_jobs)) {
+            return id;
+        }
+    }
+}
+
+void PayoutJobs::ExpireFinished(int64_t now) {
+    while (!m_finished.empty() && now - m_finished.front().first >= m_retention) {
+        m_jobs.erase(m_finished.front().second);
+        m_finished.pop_front();
+    }
+}
+
+bool PayoutJobs::Compact() {
+    StageTimer timer(Metrics::Stage::DbCompact);
+    std::lock_guard sync_lock(m_sync_mtx);
+    std::vector<JobJournal::Entry> entries;
+    uint64_t num_covered;
+    {
+        std::lock_guard lock(m_mtx);
+        ExpireFinished(time(nullptr));
+        entries.reserve(m_jobs.size());
+        for (auto const& entry : m_jobs) {
+            Job const& job = entry.second;
+            entries.push_back({job.id, job.time, job.state, job.address, job.txid_or_err});
+        }
+        // the changes are journaled under the same lock, so the copied jobs hold every record appended so far
+        num_covered = m_journal.NumAppended();
+    }
+    // the later changes stay pending for the new journal, the requests go on while it is written and synced
+    return m_journal.Rewrite(m_path, entries, num_covered);
+}
+
+bool PayoutJobs::SyncJournal() {
+    std::lock_guard lock(m_sync_mtx);
+    return m_journal.Sync();
+}
+
+void PayoutJobs::BackgroundLoop(std::chrono::milliseconds sync_interval, std::chrono::seconds compact_interval) {
+    auto next_compact = std::chrono::steady_clock::now() + compact_interval;
+    std::unique_lock lock(m_bg_mtx);
+    while (!m_bg_stop) {
+        m_bg_cv.wait_for(lock, sync_interval, [this]() { return m_bg_stop; });
+        lock.unlock();
+        {
+            StageTimer timer(Metrics::Stage::DbSync);
+            if (!SyncJournal()) {
+                PLOG_ERROR << "cannot sync the journal of payout jobs: " << m_path;
+            }
+        }
+        {
+            std::lock_guard jobs_lock(m_mtx);
+            ExpireFinished(time(nullptr));
+        }
+        if (std::chrono::steady_clock::now() >= next_compact) {
+            PLOG_DEBUG << "compacting the journal of payout jobs " << m_path;
+            if (!Compact()) {
+                PLOG_ERROR << "cannot compact the journal of payout jobs: " << m_path;
+            }
+            next_compact = std::chrono::steady_clock::now() + compact_interval;
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef FAUCET_PAYOUT_JOBS_H
+#define FAUCET_PAYOUT_JOBS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "job_journal.h"
+
+/**
+ * The payout queue of the job mode. A request only queues a job for its address and is answered with the job id,
+ * the jobs are taken by the executor later and their states can be queried until `retention` after they finished.
+ *
+ * Every state change is appended to a journal which a background thread syncs every `sync_interval` and rewrites with
+ * only the retained jobs every `compact_interval`. The jobs are synced as sending before they are paid, a job which is
+ * still sending on replay is failed instead of being paid again, since the payout might have been made.
+ *
+ * A submitted job is answered before its record is synced, so a crash within `sync_interval` after the answer loses
+ * the job: its id is unknown after the restart and the address has no cooldown, the client can simply request again.
+ */
+class PayoutJobs {
+public:
+    struct Job {
+        uint64_t id;
+        JobState state;
+        std::string address;
+        std::string txid_or_err;
+        int64_t time;  // when the job is queued or finished
+    };
+
+    enum class SubmitResult { Queued, Existing, Cooldown, Full };
+
+    /// Returns true with the message when the address is cooling down
+    using CooldownCheck = std::function<bool(std::string const& address, std::string& out_msg)>;
+
+    PayoutJobs(std::size_t max_queued, std::chrono::seconds retention, CooldownCheck check_cooldown)
+        : m_max_queued(max_queued), m_retention(retention.count()), m_check_cooldown(std::move(check_cooldown)) {}
+
+    ~PayoutJobs();
+
+    using InterruptedCallback = std::function<void(std::string const& address)>;
+
+    /**
+     * Replay the journal at `path`, the queued jobs are taken again. The addresses of the jobs interrupted while sending
+     * are passed to `on_interrupted`, they might have been paid and should be cooling down.
+     */
+    bool Open(std::string const& path, std::chrono::milliseconds sync_interval, std::chrono::seconds compact_interval,
+            InterruptedCallback const& on_interrupted);
+
+    /**
+     * Queue a job for the address, the id of the unfinished job is returned when the address already has one. The
+     * cooldown is checked under the lock which finishes the jobs, so a job finished right before is always seen.
+     */
+    SubmitResult Submit(std::string const& address, uint64_t& out_id, std::string& out_cooldown_msg);
+
+    bool Query(uint64_t id, Job& out_job) const;
+
+    /// Take at most `max_num` jobs in their queue order, they are synced as sending before this returns
+    std::vector<Job> Take(std::size_t max_num);
+
+    void Finish(uint64_t id, bool succ, std::string const& txid_or_err);
+
+    std::size_t QueueSize() const;
+
+    static char const* StateToString(JobState state);
+
+private:
+    /// Change the state and journal it, `m_mtx` must be locked
+    void SetState(Job& job, JobState state, std::string txid_or_err);
+
+    /// A random id which isn't taken, `m_mtx` must be locked
+    uint64_t NewId();
+
+    /// Drop the finished jobs out of retention, `m_mtx` must be locked
+    void ExpireFinished(int64_t now);
+
+    /// Rewrite the journal with the retained jobs, the jobs are only locked while they are copied
+    bool Compact();
+
+    bool SyncJournal();
+
+    void BackgroundLoop(std::chrono::milliseconds sync_interval, std::chrono::seconds compact_interval);
+
+private:
+    std::size_t m_max_queued;
+    int64_t m_retention;
+    CooldownCheck m_check_cooldown;
+    mutable std::mutex m_mtx;
+    std::unordered_map<uint64_t, Job> m_jobs;
+    std::deque<uint64_t> m_queue;
+    // the unfinished job of each address
+    std::unordered_map<std::string, uint64_t> m_active;
+    // finish times are increasing, so the expired jobs are at the front
+    std::deque<std::pair<int64_t, uint64_t>> m_finished;
+    // the ids are the only key to the status of a job, so they are drawn from the system's random source
+    std::random_device m_random;
+    std::string m_path;
+    JobJournal m_journal;
+    // held by the syncs and the compaction, a record synced to the journal being replaced would be lost
+    std::mutex m_sync_mtx;
+    std::mutex m_bg_mtx;
+    std::condition_variable m_bg_cv;
+    bool m_bg_stop{false};
+    std::thread m_bg_thread;
+};
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef FAUCET_RATE_LIMITER_HPP
+#define FAUCET_RATE_LIMITER_HPP
+
+#include <asio.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * Token buckets per client network. Clients are aggregated by their IPv4 or IPv6 prefix, the table is split into
+ * lock-striped shards and idle buckets are evicted by the shard while it is updated.
+ */
+class RateLimiter {
+public:
+    struct Options {
+        double rate{0};  // tokens refilled per second, 0 disables the limiter
+        double burst{10};
+        int ipv4_prefix{32};
+        int ipv6_prefix{64};
+        std::chrono::seconds idle_timeout{300};
+    };
+
+    explicit RateLimiter(Options const& opts) : m_opts(opts) {}
+
+    bool IsEnabled() const { return m_opts.rate > 0; }
+
+    /// Whether the client has any token left, nothing is consumed
+    bool Allow(asio::ip::address const& addr) { return Update(addr, 0); }
+
+    /// Take one token, returns false when the client is over the limit
+    bool Consume(asio::ip::address const& addr) { return Update(addr, 1); }
+
+    std::size_t Size() const {
+        std::size_t total{0};
+        for (auto const& shard : m_shards) {
+            std::lock_guard lock(shard.mtx);
+            total += shard.buckets.size();
+        }
+        return total;
+    }
+
+private:
+    static const std::size_t NUM_SHARDS = 64;
+
+    static const std::size_t EVICT_EVERY_OPS = 4096;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Key {
+        uint64_t hi;
+        uint64_t lo;
+
+        bool operator==(Key const& rhs) const { return hi == rhs.hi && lo == rhs.lo; }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(Key const& key) const {
+            return std::hash<uint64_t>()(key.hi * 0x9e3779b97f4a7c15ull ^ key.lo);
+        }
+    };
+
+    struct Bucket {
+        double tokens;
+        Clock::time_point last;
+    };
+
+    struct alignas(64) Shard {
+        mutable std::mutex mtx;
+        std::unordered_map<Key, Bucket, KeyHash> buckets;
+        std::size_t ops{0};
+    };
+
+    /// IPv4 addresses are mapped into IPv6 so that both families share one key type
+    Key MakeKey(asio::ip::address const& addr) const {
+        std::array<uint8_t, 16> bytes;
+        int prefix;
+        if (addr.is_v4() || (addr.is_v6() && addr.to_v6().is_v4_mapped())) {
+            asio::ip::address_v4 v4 =
+                    addr.is_v4() ? addr.to_v4() : asio::ip::make_address_v4(asio::ip::v4_mapped, addr.to_v6());
+            bytes = asio::ip::make_address_v6(asio::ip::v4_mapped, v4).to_bytes();
+            prefix = 96 + std::clamp(m_opts.ipv4_prefix, 0, 32);
+        } else {
+            bytes = addr.to_v6().to_bytes();
+            prefix = std::clamp(m_opts.ipv6_prefix, 0, 128);
+        }
+        Key key{0, 0};
+        for (int i = 0; i < 8; ++i) {
+            key.hi = (key.hi << 8) | bytes[i];
+            key.lo = (key.lo << 8) | bytes[i + 8];
+        }
+        key.hi &= prefix >= 64 ? ~0ull : (prefix == 0 ? 0 : ~0ull << (64 - prefix));
+        key.lo &= prefix >= 128 ? ~0ull : (prefix <= 64 ? 0 : ~0ull << (128 - prefix));
+        return key;
+    }
+
+    bool Update(asio::ip::address const& addr, double cost) {
+        if (!IsEnabled()) {
+            return true;
+        }
+        Key key = MakeKey(addr);
+        Shard& shard = m_shards[KeyHash()(key) % NUM_SHARDS];
+        auto now = Clock::now();
+        std::lock_guard lock(shard.mtx);
+        if (++shard.ops % EVICT_EVERY_OPS == 0) {
+            EvictIdle(shard, now);
+        }
+        auto res = shard.buckets.try_emplace(key, Bucket{m_opts.burst, now});
+        Bucket& bucket = res.first->second;
+        std::chrono::duration<double> elapsed = now - bucket.last;
+        bucket.tokens = std::min(m_opts.burst, bucket.tokens + elapsed.count() * m_opts.rate);
+        bucket.last = now;
+        if (bucket.tokens < std::max(cost, 1.0)) {
+            return false;
+        }
+        bucket.tokens -= cost;
+        return true;
+    }
+
+    void EvictIdle(Shard& shard, Clock::time_point now) {
+        for (auto i = std::begin(shard.buckets); i != std::end(shard.buckets);) {
+            if (now - i->second.last >= m_opts.idle_timeout) {
+                i = shard.buckets.erase(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+private:
+    Options m_opts;
+    std::array<Shard, NUM_SHARDS> m_shards;
+};
+
+#endif
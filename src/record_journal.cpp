@@ -0,0 +1,246 @@
+#include "record_journal.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <plog/Log.h>
+
+namespace {
+
+/// Write the whole buffer unless an error other than `EINTR` happens
+bool WriteAll(int fd, char const* p, std::size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool RecordJournal::SyncParentDir(std::string const& path) {
+    auto pos = path.find_last_of('/');
+    std::string dir = pos == std::string::npos ? "." : (pos == 0 ? "/" : path.substr(0, pos));
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd == -1) {
+        return false;
+    }
+    bool succ = fsync(fd) == 0;
+    close(fd);
+    return succ;
+}
+
+RecordJournal::~RecordJournal() {
+    Sync();
+    Close();
+}
+
+std::size_t RecordJournal::Replay(std::string const& path, std::size_t record_size, uint32_t magic,
+        ReplayCallback const& callback) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return 0;
+    }
+    std::size_t total{0};
+    std::vector<char> buf(record_size * 256);
+    while (true) {
+        ssize_t n = read(fd, buf.data(), buf.size());
+        if (n <= 0) {
+            break;
+        }
+        std::size_t num_records = n / record_size;
+        for (std::size_t i = 0; i < num_records; ++i) {
+            char const* record = buf.data() + i * record_size;
+            Header header;
+            memcpy(&header, record, sizeof(header));
+            if (header.magic != magic || header.checksum != CalcChecksum(record, record_size)) {
+                // the tail is torn, nothing behind it can be trusted
+                close(fd);
+                return total;
+            }
+            callback(record);
+            ++total;
+        }
+        if (n % record_size != 0) {
+            break;
+        }
+    }
+    close(fd);
+    return total;
+}
+
+bool RecordJournal::Open(std::string const& path) {
+    std::lock_guard lock(m_file_mtx);
+    Close();
+    std::size_t num_records = Replay(path, m_record_size, m_magic, [](void const*) {});
+    m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (m_fd == -1) {
+        PLOG_ERROR << "cannot open journal to write: " << path << ", " << strerror(errno);
+        return false;
+    }
+    off_t valid_size = static_cast<off_t>(num_records * m_record_size);
+    if (lseek(m_fd, 0, SEEK_END) > valid_size) {
+        PLOG_ERROR << "journal " << path << " has a torn tail, truncate it to " << num_records << " record(s)";
+        if (ftruncate(m_fd, valid_size) != 0) {
+            PLOG_ERROR << "cannot truncate journal: " << strerror(errno);
+            Close();
+            return false;
+        }
+    }
+    m_path = path;
+    return true;
+}
+
+bool RecordJournal::Rewrite(std::string const& path, void const* records, std::size_t num, uint64_t num_covered) {
+    std::vector<char> buf(static_cast<char const*>(records), static_cast<char const*>(records) + num * m_record_size);
+    for (std::size_t i = 0; i < num; ++i) {
+        Seal(buf.data() + i * m_record_size);
+    }
+    // nothing is written to the file until it is replaced, so the pending records only grow in between
+    std::lock_guard lock(m_file_mtx);
+    {
+        std::lock_guard pending_lock(m_pending_mtx);
+        if (m_num_appended - m_pending.size() / m_record_size > num_covered) {
+            PLOG_ERROR << "journal " << path << " has synced records which the rewrite doesn't cover";
+            return false;
+        }
+    }
+    std::string tmp_path = path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        PLOG_ERROR << "cannot open journal to write: " << tmp_path << ", " << strerror(errno);
+        return false;
+    }
+    if (!WriteAll(fd, buf.data(), buf.size()) || fsync(fd) != 0) {
+        PLOG_ERROR << "cannot write journal: " << tmp_path << ", " << strerror(errno);
+        close(fd);
+        return false;
+    }
+    close(fd);
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+        PLOG_ERROR << "cannot replace journal: " << path << ", " << strerror(errno);
+        return false;
+    }
+    if (!SyncParentDir(path)) {
+        PLOG_ERROR << "cannot sync the directory of journal: " << path << ", " << strerror(errno);
+        return false;
+    }
+    Close();
+    m_fd = open(path.c_str(), O_WRONLY | O_APPEND);
+    if (m_fd == -1) {
+        PLOG_ERROR << "cannot open journal to write: " << path << ", " << strerror(errno);
+        return false;
+    }
+    m_path = path;
+    // the covered records are in the new file already, the later ones stay pending for it
+    std::lock_guard pending_lock(m_pending_mtx);
+    uint64_t num_written = m_num_appended - m_pending.size() / m_record_size;
+    m_pending.erase(std::begin(m_pending), std::begin(m_pending) + (num_covered - num_written) * m_record_size);
+    return true;
+}
+
+void RecordJournal::Append(void const* record) {
+    std::lock_guard lock(m_pending_mtx);
+    std::size_t offset = m_pending.size();
+    m_pending.insert(std::end(m_pending), static_cast<char const*>(record),
+            static_cast<char const*>(record) + m_record_size);
+    Seal(m_pending.data() + offset);
+    ++m_num_appended;
+}
+
+uint64_t RecordJournal::NumAppended() const {
+    std::lock_guard lock(m_pending_mtx);
+    return m_num_appended;
+}
+
+bool RecordJournal::Sync() {
+    std::lock_guard lock(m_file_mtx);
+    return WritePending();
+}
+
+bool RecordJournal::Rotate(std::string const& rotated_path) {
+    std::lock_guard lock(m_file_mtx);
+    if (!WritePending()) {
+        return false;
+    }
+    if (rename(m_path.c_str(), rotated_path.c_str()) != 0) {
+        PLOG_ERROR << "cannot rotate journal to " << rotated_path << ": " << strerror(errno);
+        return false;
+    }
+    Close();
+    m_fd = open(m_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (m_fd == -1) {
+        PLOG_ERROR << "cannot open journal to write: " << m_path << ", " << strerror(errno);
+        return false;
+    }
+    if (!SyncParentDir(m_path)) {
+        PLOG_ERROR << "cannot sync the directory of journal: " << m_path << ", " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+void RecordJournal::Seal(char* record) const {
+    Header header{m_magic, CalcChecksum(record, m_record_size)};
+    memcpy(record, &header, sizeof(header));
+}
+
+uint32_t RecordJournal::CalcChecksum(char const* record, std::size_t record_size) {
+    // FNV-1a over everything behind the header
+    uint32_t hash = 2166136261u;
+    auto p = reinterpret_cast<uint8_t const*>(record) + sizeof(Header);
+    auto end = reinterpret_cast<uint8_t const*>(record) + record_size;
+    for (; p != end; ++p) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+bool RecordJournal::WritePending() {
+    std::vector<char> pending;
+    {
+        std::lock_guard lock(m_pending_mtx);
+        pending.swap(m_pending);
+    }
+    if (pending.empty()) {
+        return true;
+    }
+    if (m_fd == -1) {
+        PLOG_ERROR << "journal isn't opened, " << pending.size() / m_record_size << " record(s) are lost";
+        return false;
+    }
+    off_t old_size = lseek(m_fd, 0, SEEK_END);
+    if (!WriteAll(m_fd, pending.data(), pending.size())) {
+        PLOG_ERROR << "cannot write journal: " << strerror(errno);
+        // cut the partial write and keep the records for the next try
+        if (ftruncate(m_fd, old_size) != 0) {
+            PLOG_ERROR << "cannot truncate journal: " << strerror(errno);
+        }
+        std::lock_guard lock(m_pending_mtx);
+        m_pending.insert(std::begin(m_pending), std::begin(pending), std::end(pending));
+        return false;
+    }
+    if (fdatasync(m_fd) != 0) {
+        PLOG_ERROR << "cannot sync journal: " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+void RecordJournal::Close() {
+    if (m_fd != -1) {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef FAUCET_RECORD_JOURNAL_H
+#define FAUCET_RECORD_JOURNAL_H
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Append-only file of fixed-size records, every record starts with a `Header` and the checksum covers the bytes
+ * behind it. Appended records are buffered in memory and written with one `write` + `fdatasync` by `Sync`, a record
+ * torn by a crash is detected by its checksum and nothing behind it is replayed.
+ */
+class RecordJournal {
+public:
+    struct Header {
+        uint32_t magic;
+        uint32_t checksum;
+    };
+
+    using ReplayCallback = std::function<void(void const* record)>;
+
+    RecordJournal(std::size_t record_size, uint32_t magic) : m_record_size(record_size), m_magic(magic) {}
+
+    ~RecordJournal();
+
+    RecordJournal(RecordJournal const&) = delete;
+
+    RecordJournal& operator=(RecordJournal const&) = delete;
+
+    /// Read all valid records from the journal file, returns the number of them
+    static std::size_t Replay(std::string const& path, std::size_t record_size, uint32_t magic,
+            ReplayCallback const& callback);
+
+    /// Sync the directory holding `path`, so a file renamed into it survives a crash
+    static bool SyncParentDir(std::string const& path);
+
+    /// Open the journal file for appending, the torn record at the tail will be truncated
+    bool Open(std::string const& path);
+
+    /**
+     * Replace the journal file atomically by one holding only `num` records, they cover the first `num_covered`
+     * appended records (see `NumAppended`). The pending records appended later are kept for the new file. It fails when
+     * one of those later records has been synced to the old file already, the syncs must be held off in between.
+     */
+    bool Rewrite(std::string const& path, void const* records, std::size_t num, uint64_t num_covered);
+
+    /// Buffer the record, its header is filled here and it reaches the disk on next `Sync`
+    void Append(void const* record);
+
+    /// How many records have been appended since the journal is created
+    uint64_t NumAppended() const;
+
+    bool Sync();
+
+    /// Sync and move the journal to `rotated_path`, following records go to a new empty journal
+    bool Rotate(std::string const& rotated_path);
+
+private:
+    void Seal(char* record) const;
+
+    static uint32_t CalcChecksum(char const* record, std::size_t record_size);
+
+    bool WritePending();
+
+    void Close();
+
+private:
+    std::size_t m_record_size;
+    uint32_t m_magic;
+    mutable std::mutex m_pending_mtx;
+    std::vector<char> m_pending;
+    uint64_t m_num_appended{0};
+    std::mutex m_file_mtx;
+    std::string m_path;
+    int m_fd{-1};
+};
+
+#endif
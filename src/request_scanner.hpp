@@ -0,0 +1,343 @@
+#ifndef FAUCET_REQUEST_SCANNER_HPP
+#define FAUCET_REQUEST_SCANNER_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * Single-pass scanner for the request body `{"address": "..."}`, it reads the address without building a json tree
+ * and without allocating anything but the address itself.
+ *
+ * Only strict RFC 8259 json is accepted, with the same result as jsoncpp for such input: the root must be an object
+ * and the last member `address` wins. Whatever jsoncpp might read differently, comments, trailing bytes, raw control
+ * characters, surrogate escapes, escaped keys, exponents or deep nesting, is left to the full parser.
+ */
+class RequestScanner {
+public:
+    enum class Result {
+        Found,      // the address is a string
+        NoAddress,  // the body is an object without a string member `address`, or not an object
+        Fallback    // use the full json parser
+    };
+
+    static Result ScanAddress(std::string_view body, std::string& out_address) {
+        RequestScanner scanner(body);
+        return scanner.ScanRoot(out_address);
+    }
+
+private:
+    static const int MAX_DEPTH = 64;
+
+    static const std::size_t MAX_NUMBER_DIGITS = 15;
+
+    explicit RequestScanner(std::string_view body) : m_body(body) {}
+
+    Result ScanRoot(std::string& out_address) {
+        SkipWhitespace();
+        if (Peek() != '{') {
+            return SkipValue(0) && AtEnd() ? Result::NoAddress : Result::Fallback;
+        }
+        ++m_pos;
+        bool found{false};
+        SkipWhitespace();
+        if (Peek() == '}') {
+            ++m_pos;
+            return AtEnd() ? Result::NoAddress : Result::Fallback;
+        }
+        while (true) {
+            SkipWhitespace();
+            std::string_view key;
+            if (!ScanKey(key)) {
+                return Result::Fallback;
+            }
+            SkipWhitespace();
+            if (Peek() != ':') {
+                return Result::Fallback;
+            }
+            ++m_pos;
+            SkipWhitespace();
+            if (key == "address") {
+                if (Peek() == '"') {
+                    out_address.clear();
+                    if (!ScanString(&out_address)) {
+                        return Result::Fallback;
+                    }
+                    found = true;
+                } else {
+                    // the last member wins, a later non-string address hides the earlier ones
+                    if (!SkipValue(1)) {
+                        return Result::Fallback;
+                    }
+                    found = false;
+                }
+            } else if (!SkipValue(1)) {
+                return Result::Fallback;
+            }
+            SkipWhitespace();
+            char ch = Peek();
+            ++m_pos;
+            if (ch == '}') {
+                break;
+            }
+            if (ch != ',') {
+                return Result::Fallback;
+            }
+        }
+        if (!AtEnd()) {
+            return Result::Fallback;
+        }
+        return found ? Result::Found : Result::NoAddress;
+    }
+
+    char Peek() const { return m_pos < m_body.size() ? m_body[m_pos] : '\0'; }
+
+    void SkipWhitespace() {
+        while (m_pos < m_body.size()) {
+            char ch = m_body[m_pos];
+            if (ch != ' ' && ch != '\t' && ch != '\n' && ch != '\r') {
+                break;
+            }
+            ++m_pos;
+        }
+    }
+
+    /// Only trailing whitespace can follow the root
+    bool AtEnd() {
+        SkipWhitespace();
+        return m_pos == m_body.size();
+    }
+
+    /// Keys with escapes are left to the full parser, so a plain key is a view of the body
+    bool ScanKey(std::string_view& out_key) {
+        if (Peek() != '"') {
+            return false;
+        }
+        std::size_t begin = ++m_pos;
+        while (m_pos < m_body.size()) {
+            auto ch = static_cast<unsigned char>(m_body[m_pos]);
+            if (ch == '"') {
+                out_key = m_body.substr(begin, m_pos - begin);
+                ++m_pos;
+                return true;
+            }
+            if (ch == '\\' || ch < 0x20) {
+                return false;
+            }
+            ++m_pos;
+        }
+        return false;
+    }
+
+    /// Scan a string and decode it into `out` unless it is null
+    bool ScanString(std::string* out) {
+        ++m_pos;  // '"'
+        std::size_t run_begin = m_pos;
+        while (m_pos < m_body.size()) {
+            auto ch = static_cast<unsigned char>(m_body[m_pos]);
+            if (ch == '"') {
+                if (out) {
+                    out->append(m_body.substr(run_begin, m_pos - run_begin));
+                }
+                ++m_pos;
+                return true;
+            }
+            if (ch < 0x20) {
+                return false;
+            }
+            if (ch != '\\') {
+                ++m_pos;
+                continue;
+            }
+            if (out) {
+                out->append(m_body.substr(run_begin, m_pos - run_begin));
+            }
+            if (++m_pos >= m_body.size()) {
+                return false;
+            }
+            char decoded;
+            switch (m_body[m_pos]) {
+                case '"':
+                    decoded = '"';
+                    break;
+                case '\\':
+                    decoded = '\\';
+                    break;
+                case '/':
+                    decoded = '/';
+                    break;
+                case 'b':
+                    decoded = '\b';
+                    break;
+                case 'f':
+                    decoded = '\f';
+                    break;
+                case 'n':
+                    decoded = '\n';
+                    break;
+                case 'r':
+                    decoded = '\r';
+                    break;
+                case 't':
+                    decoded = '\t';
+                    break;
+                case 'u': {
+                    uint32_t cp;
+                    if (!ScanHex4(cp)) {
+                        return false;
+                    }
+                    if (out) {
+                        AppendUtf8(*out, cp);
+                    }
+                    run_begin = m_pos;
+                    continue;
+                }
+                default:
+                    return false;
+            }
+            if (out) {
+                out->push_back(decoded);
+            }
+            run_begin = ++m_pos;
+        }
+        return false;
+    }
+
+    /// Read the 4 hex digits after `\u`, the surrogates are left to the full parser
+    bool ScanHex4(uint32_t& out_cp) {
+        if (m_pos + 5 > m_body.size()) {
+            return false;
+        }
+        out_cp = 0;
+        for (std::size_t i = m_pos + 1; i < m_pos + 5; ++i) {
+            char ch = m_body[i];
+            out_cp <<= 4;
+            if (ch >= '0' && ch <= '9') {
+                out_cp |= ch - '0';
+            } else if (ch >= 'a' && ch <= 'f') {
+                out_cp |= ch - 'a' + 10;
+            } else if (ch >= 'A' && ch <= 'F') {
+                out_cp |= ch - 'A' + 10;
+            } else {
+                return false;
+            }
+        }
+        m_pos += 5;
+        return out_cp < 0xd800 || out_cp > 0xdfff;
+    }
+
+    static void AppendUtf8(std::string& out, uint32_t cp) {
+        if (cp < 0x80) {
+            out.push_back(static_cast<char>(cp));
+        } else if (cp < 0x800) {
+            out.push_back(static_cast<char>(0xc0 | (cp >> 6)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+        } else {
+            out.push_back(static_cast<char>(0xe0 | (cp >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+        }
+    }
+
+    bool SkipValue(int depth) {
+        if (depth > MAX_DEPTH) {
+            return false;
+        }
+        switch (Peek()) {
+            case '"':
+                return ScanString(nullptr);
+            case '{':
+                return SkipContainer(depth, '}', true);
+            case '[':
+                return SkipContainer(depth, ']', false);
+            case 't':
+                return SkipLiteral("true");
+            case 'f':
+                return SkipLiteral("false");
+            case 'n':
+                return SkipLiteral("null");
+            default:
+                return SkipNumber();
+        }
+    }
+
+    bool SkipContainer(int depth, char close, bool is_object) {
+        ++m_pos;
+        SkipWhitespace();
+        if (Peek() == close) {
+            ++m_pos;
+            return true;
+        }
+        while (true) {
+            SkipWhitespace();
+            if (is_object) {
+                if (Peek() != '"' || !ScanString(nullptr)) {
+                    return false;
+                }
+                SkipWhitespace();
+                if (Peek() != ':') {
+                    return false;
+                }
+                ++m_pos;
+                SkipWhitespace();
+            }
+            if (!SkipValue(depth + 1)) {
+                return false;
+            }
+            SkipWhitespace();
+            char ch = Peek();
+            ++m_pos;
+            if (ch == close) {
+                return true;
+            }
+            if (ch != ',') {
+                return false;
+            }
+        }
+    }
+
+    bool SkipLiteral(std::string_view literal) {
+        if (m_body.substr(m_pos, literal.size()) != literal) {
+            return false;
+        }
+        m_pos += literal.size();
+        return true;
+    }
+
+    /// -?(0|[1-9][0-9]*)(\.[0-9]+)?, numbers with exponents or too many digits might be out of the range of jsoncpp
+    bool SkipNumber() {
+        auto is_digit = [this]() { return Peek() >= '0' && Peek() <= '9'; };
+        if (Peek() == '-') {
+            ++m_pos;
+        }
+        std::size_t num_digits{0};
+        if (Peek() == '0') {
+            ++m_pos;
+            ++num_digits;
+        } else if (is_digit()) {
+            while (is_digit()) {
+                ++m_pos;
+                ++num_digits;
+            }
+        } else {
+            return false;
+        }
+        if (Peek() == '.') {
+            ++m_pos;
+            if (!is_digit()) {
+                return false;
+            }
+            while (is_digit()) {
+                ++m_pos;
+                ++num_digits;
+            }
+        }
+        return num_digits <= MAX_NUMBER_DIGITS && Peek() != 'e' && Peek() != 'E';
+    }
+
+private:
+    std::string_view m_body;
+    std::size_t m_pos{0};
+};
+
+#endif
@@ -1,15 +1,19 @@
 #include "rpc_client.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 
 #include <filesystem>
 namespace fs = std::filesystem;
 
+#include "metrics.hpp"
 #include "utils.hpp"
 
-RPCClient::RPCClient(bool no_proxy, std::string url, std::string const& cookie_path_str)
-    : m_no_proxy(no_proxy), m_url(std::move(url)) {
+RPCClient::Backend RPCClient::MakeCookieBackend(std::string url, std::string const& cookie_path_str) {
     if (cookie_path_str.empty()) {
         throw std::runtime_error("cookie is empty, cannot connect to btchd core");
     }
@@ -27,24 +31,416 @@ RPCClient::RPCClient(bool no_proxy, std::string url, std::string const& cookie_p
         throw std::runtime_error("cannot read auth string from `.cookie`");
     }
     auto pos = auth_str.find_first_of(':');
-    std::string user_str = auth_str.substr(0, pos);
-    std::string passwd_str = auth_str.substr(pos + 1);
-    m_user = std::move(user_str);
-    m_passwd = std::move(passwd_str);
+    Backend backend;
+    backend.url = std::move(url);
+    backend.user = auth_str.substr(0, pos);
+    backend.passwd = auth_str.substr(pos + 1);
+    return backend;
 }
 
+RPCClient::RPCClient(bool no_proxy, std::string url, std::string const& cookie_path_str)
+    : RPCClient(no_proxy, std::vector<Backend>{MakeCookieBackend(std::move(url), cookie_path_str)}) {}
+
 RPCClient::RPCClient(bool no_proxy, std::string url, std::string user, std::string passwd)
-    : m_no_proxy(no_proxy), m_url(std::move(url)), m_user(std::move(user)), m_passwd(std::move(passwd)) {}
+    : RPCClient(no_proxy, std::vector<Backend>{Backend{std::move(url), std::move(user), std::move(passwd)}}) {}
+
+RPCClient::RPCClient(bool no_proxy, std::vector<Backend> backends) : m_no_proxy(no_proxy) {
+    if (backends.empty()) {
+        throw std::runtime_error("no backend is given to the RPC client");
+    }
+    for (auto& backend : backends) {
+        auto node = std::make_unique<Node>();
+        node->backend = std::move(backend);
+        m_nodes.push_back(std::move(node));
+    }
+}
+
+void RPCClient::ProbeBackends() {
+    for (auto& pnode : m_nodes) {
+        Node& node = *pnode;
+        std::string reason;
+        try {
+            Batch batch;
+            int chain_id = batch.Add("getblockchaininfo");
+            int wallet_id = batch.Add("getwalletinfo");
+            // sent to this node only, the probe must not fail over
+            batch.m_calls.push_back(']');
+            Json::Value res = PostRequest(node, "batch", batch.m_calls);
+            ReadBatch(batch, res);
+            Json::Value const& chain = batch.GetResult(chain_id);
+            Json::Value const& wallet = batch.GetResult(wallet_id);
+            if (chain["initialblockdownload"].asBool()) {
+                reason = "the node is in initial block download";
+            } else if (wallet.isMember("unlocked_until") && wallet["unlocked_until"].asInt64() == 0) {
+                // an unencrypted wallet has no `unlocked_until`
+                reason = "the wallet is locked";
+            }
+        } catch (std::exception const& e) {
+            reason = e.what();
+        }
+        SetHealth(node, reason);
+    }
+}
 
 std::string RPCClient::SendToAddress(std::string const& address, uint64_t amount) {
-    auto result = SendMethod(m_no_proxy, "sendtoaddress", address, amount);
+    auto result = SendMethod("sendtoaddress", address, amount);
+    return result.result.asString();
+}
+
+std::string RPCClient::SendMany(std::map<std::string, uint64_t> const& amounts) {
+    // the first parameter is the legacy `dummy` account which must be empty
+    auto result = SendMethod("sendmany", std::string(), amounts);
+    return result.result.asString();
+}
+
+std::string RPCClient::SendMany(std::map<std::string, std::string> const& amounts) {
+    auto result = SendMethod("sendmany", std::string(), amounts);
+    return result.result.asString();
+}
+
+std::vector<RPCClient::Unspent> RPCClient::ListUnspent(int min_conf, int max_conf) {
+    auto result = SendMethod("listunspent", min_conf, max_conf);
+    if (!result.result.isArray()) {
+        throw Error("invalid result of `listunspent`");
+    }
+    std::vector<Unspent> unspents;
+    unspents.reserve(result.result.size());
+    for (auto const& entry : result.result) {
+        Unspent unspent;
+        unspent.outpoint.txid = entry["txid"].asString();
+        unspent.outpoint.vout = entry["vout"].asInt();
+        unspent.address = entry["address"].asString();
+        unspent.label = entry["label"].asString();
+        unspent.amount = ParseAmount(entry["amount"]);
+        unspent.confirmations = entry["confirmations"].asInt();
+        unspent.spendable = entry["spendable"].asBool();
+        unspents.push_back(std::move(unspent));
+    }
+    return unspents;
+}
+
+std::vector<std::string> RPCClient::GetNewAddresses(std::string const& label, int num) {
+    Batch batch;
+    for (int i = 0; i < num; ++i) {
+        batch.Add("getnewaddress", label);
+    }
+    SendBatch(batch);
+    std::vector<std::string> addresses;
+    addresses.reserve(num);
+    for (int i = 0; i < num; ++i) {
+        addresses.push_back(batch.GetResult(i).asString());
+    }
+    return addresses;
+}
+
+std::string RPCClient::CreateRawTransaction(
+        std::vector<Outpoint> const& inputs, std::map<std::string, std::string> const& outputs) {
+    auto result = SendMethod("createrawtransaction", inputs, outputs);
     return result.result.asString();
 }
 
-void RPCClient::BuildRPCJson(Json::Value& params, std::string const& val) { params.append(val); }
+std::string RPCClient::SignRawTransactionWithWallet(std::string const& hex) {
+    auto result = SendMethod("signrawtransactionwithwallet", hex);
+    if (!result.result["complete"].asBool()) {
+        throw Error("the wallet cannot sign all inputs of the transaction");
+    }
+    return result.result["hex"].asString();
+}
 
-void RPCClient::BuildRPCJson(Json::Value& params, Bytes const& val) { params.append(BytesToHex(val)); }
+std::string RPCClient::SendRawTransaction(std::string const& hex) {
+    auto result = SendMethod("sendrawtransaction", hex);
+    return result.result.asString();
+}
 
-void RPCClient::BuildRPCJson(Json::Value& params, bool val) { params.append(Json::Value(val)); }
+std::string RPCClient::FormatAmount(int64_t amount) {
+    char buf[32];
+    char const* sign = amount < 0 ? "-" : "";
+    uint64_t abs_amount = amount < 0 ? -static_cast<uint64_t>(amount) : amount;
+    snprintf(buf, sizeof(buf), "%s%llu.%08llu", sign, static_cast<unsigned long long>(abs_amount / COIN),
+            static_cast<unsigned long long>(abs_amount % COIN));
+    return buf;
+}
+
+int64_t RPCClient::ParseAmount(Json::Value const& amount) {
+    if (amount.isString()) {
+        return std::llround(std::stod(amount.asString()) * COIN);
+    }
+    return std::llround(amount.asDouble() * COIN);
+}
+
+Json::Value const& RPCClient::Batch::GetResult(int id) const {
+    if (id < 0 || id >= static_cast<int>(m_responses.size()) || !m_responses[id].received) {
+        std::stringstream ss;
+        ss << "no response for the call with id " << id;
+        throw Error(ss.str().c_str());
+    }
+    Response const& response = m_responses[id];
+    if (response.err_code != 0 || !response.err_msg.empty()) {
+        throw RPCError(response.err_code, response.err_msg);
+    }
+    return response.result;
+}
+
+void RPCClient::SendBatch(Batch& batch) {
+    if (batch.Size() == 0) {
+        batch.m_responses.clear();
+        return;
+    }
+    batch.m_calls.push_back(']');
+    Json::Value res = SendRequest("batch", batch.m_calls);
+    batch.m_calls.pop_back();
+    ReadBatch(batch, res);
+}
+
+void RPCClient::ReadBatch(Batch& batch, Json::Value const& res) {
+    batch.m_responses.clear();
+    batch.m_responses.resize(batch.Size());
+    if (!res.isArray()) {
+        // the node answers a single error object when the batch itself cannot be handled
+        if (res.isObject() && res.isMember("error") && !res["error"].isNull()) {
+            throw RPCError(res["error"]["code"].asInt(), res["error"]["message"].asString());
+        }
+        throw Error("invalid result of batch from rpc server");
+    }
+    for (auto const& entry : res) {
+        if (!entry.isObject() || !entry.isMember("id") || !entry["id"].isInt()) {
+            continue;
+        }
+        int id = entry["id"].asInt();
+        if (id < 0 || id >= static_cast<int>(batch.Size())) {
+            continue;
+        }
+        Batch::Response& response = batch.m_responses[id];
+        response.received = true;
+        if (entry.isMember("error") && !entry["error"].isNull()) {
+            response.err_code = entry["error"]["code"].asInt();
+            response.err_msg = entry["error"]["message"].asString();
+        } else {
+            response.result = entry["result"];
+        }
+    }
+}
+
+namespace {
+
+/// Parse a whole json document, the reader is created once for each thread
+bool ParseJson(std::string_view data, Json::Value& out_root) {
+    thread_local std::unique_ptr<Json::CharReader> reader(Json::CharReaderBuilder().newCharReader());
+    std::string errs;
+    return reader->parse(data.data(), data.data() + data.size(), &out_root, &errs);
+}
 
-void RPCClient::BuildRPCJsonWithParams(Json::Value& out_params) {}
+bool IsConnectError(int code) {
+    // no transfer timeout is set, so a timeout can only happen while connecting
+    return code == CURLE_COULDNT_RESOLVE_PROXY || code == CURLE_COULDNT_RESOLVE_HOST ||
+           code == CURLE_COULDNT_CONNECT || code == CURLE_OPERATION_TIMEDOUT;
+}
+
+}  // namespace
+
+Json::Value RPCClient::SendRequest(std::string_view name, std::string const& request) {
+    StageTimer timer(Metrics::Stage::Rpc);
+    if (m_nodes.size() == 1) {
+        return PostRequest(*m_nodes.front(), name, request);
+    }
+    std::vector<Node*> nodes = RouteNodes();
+    for (std::size_t i = 0; i + 1 < nodes.size(); ++i) {
+        try {
+            return PostRequest(*nodes[i], name, request);
+        } catch (ConnectError const& e) {
+            // nothing has reached the node, so even a payout is safe to send again
+            SetHealth(*nodes[i], e.what());
+            PLOG_WARNING << "Failing over `" << name << "` to " << nodes[i + 1]->backend.url;
+        }
+    }
+    try {
+        return PostRequest(*nodes.back(), name, request);
+    } catch (ConnectError const& e) {
+        // the last node is down as well, mark it or it is routed ahead of the others until the next probe
+        SetHealth(*nodes.back(), e.what());
+        throw;
+    }
+}
+
+Json::Value RPCClient::PostRequest(Node& node, std::string_view name, std::string const& request) {
+    // Invoke curl with a pooled handle
+    ClientHolder client(*this, node);
+    PLOG_DEBUG << "sending to " << node.backend.url << ": `" << request << "`";
+    auto start = std::chrono::steady_clock::now();
+    bool succ;
+    int code;
+    std::string err_str;
+    std::tie(succ, code, err_str) = client->Send(request);
+    if (!succ) {
+        std::stringstream ss;
+        ss << "RPC command error `" << name << "` on " << node.backend.url << ": " << err_str;
+        if (IsConnectError(code)) {
+            throw ConnectError(ss.str().c_str());
+        }
+        throw NetError(ss.str().c_str());
+    }
+    RecordLatency(node, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    // Analyze the result straight from the receive buffer of the client
+    std::string_view received_data = client->GetReceivedData();
+    if (received_data.empty()) {
+        throw NetError("empty result from RPC server");
+    }
+    PLOG_DEBUG << "received: `" << received_data << "`";
+    Json::Value res;
+    if (!ParseJson(received_data, res)) {
+        throw Error("cannot parse the result from rpc server");
+    }
+    return res;
+}
+
+std::vector<RPCClient::Node*> RPCClient::RouteNodes() {
+    struct Candidate {
+        Node* node;
+        bool healthy;
+        double score;
+    };
+    std::vector<Candidate> candidates;
+    candidates.reserve(m_nodes.size());
+    for (auto& pnode : m_nodes) {
+        int in_flight = pnode->in_flight.load(std::memory_order_relaxed);
+        std::lock_guard lock(pnode->mtx);
+        // a node without any sample yet scores by its load alone, so it is tried soon
+        candidates.push_back({pnode.get(), pnode->healthy, (pnode->latency_ms + 1) * (in_flight + 1)});
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), [](Candidate const& lhs, Candidate const& rhs) {
+        return std::tie(rhs.healthy, lhs.score) < std::tie(lhs.healthy, rhs.score);
+    });
+    std::vector<Node*> nodes;
+    nodes.reserve(candidates.size());
+    for (auto const& candidate : candidates) {
+        nodes.push_back(candidate.node);
+    }
+    return nodes;
+}
+
+void RPCClient::RecordLatency(Node& node, double latency_ms) {
+    std::lock_guard lock(node.mtx);
+    if (node.latency_ms == 0) {
+        node.latency_ms = latency_ms;
+    } else {
+        node.latency_ms += LATENCY_ALPHA * (latency_ms - node.latency_ms);
+    }
+}
+
+void RPCClient::SetHealth(Node& node, std::string const& reason) {
+    bool healthy = reason.empty();
+    {
+        std::lock_guard lock(node.mtx);
+        if (node.healthy == healthy) {
+            return;
+        }
+        node.healthy = healthy;
+    }
+    if (healthy) {
+        PLOG_INFO << "RPC backend " << node.backend.url << " is healthy again";
+    } else {
+        PLOG_WARNING << "RPC backend " << node.backend.url << " is unhealthy: " << reason;
+    }
+}
+
+std::string& RPCClient::RequestBuffer() {
+    thread_local std::string buffer;
+    buffer.clear();
+    return buffer;
+}
+
+RPCClient::Result RPCClient::ParseResponse(std::string_view data, int id) {
+    Json::Value res;
+    if (!ParseJson(data, res)) {
+        throw Error("cannot parse the result from rpc server");
+    }
+    return CheckResponse(std::move(res), id);
+}
+
+RPCClient::Result RPCClient::CheckResponse(Json::Value res, int id) {
+    if (!res.isObject()) {
+        throw Error("invalid result from rpc server");
+    }
+    Json::Value& error = res["error"];
+    if (!error.isNull()) {
+        throw RPCError(error["code"].asInt(), error["message"].asString());
+    }
+    // the node echoes the id of the call, anything else is the response of another request
+    Json::Value const& res_id = res["id"];
+    if (!res_id.isInt() || res_id.asInt() != id) {
+        throw Error("mismatched id of the result from rpc server");
+    }
+    Result result;
+    result.result = std::move(res["result"]);
+    result.id = id;
+    return result;
+}
+
+std::unique_ptr<HTTPClient> RPCClient::AcquireClient(Node& node) {
+    {
+        std::lock_guard lock(node.mtx);
+        if (!node.idle_clients.empty()) {
+            auto client = std::move(node.idle_clients.back());
+            node.idle_clients.pop_back();
+            return client;
+        }
+    }
+    Backend const& backend = node.backend;
+    return std::make_unique<HTTPClient>(backend.url, backend.user, backend.passwd, m_no_proxy, m_curl_verbose);
+}
+
+void RPCClient::ReleaseClient(Node& node, std::unique_ptr<HTTPClient> client) {
+    std::lock_guard lock(node.mtx);
+    if (node.idle_clients.size() < MAX_IDLE_CLIENTS) {
+        node.idle_clients.push_back(std::move(client));
+    }
+}
+
+void RPCClient::WriteRPCJson(std::string& out, std::string_view val) {
+    out.push_back('"');
+    for (char ch : val) {
+        switch (ch) {
+            case '"':
+                out.append("\\\"");
+                break;
+            case '\\':
+                out.append("\\\\");
+                break;
+            case '\n':
+                out.append("\\n");
+                break;
+            case '\r':
+                out.append("\\r");
+                break;
+            case '\t':
+                out.append("\\t");
+                break;
+            default:
+                if (static_cast<uint8_t>(ch) < 0x20) {
+                    out.append("\\u00");
+                    out.append(ByteToHex(static_cast<uint8_t>(ch)));
+                } else {
+                    out.push_back(ch);
+                }
+        }
+    }
+    out.push_back('"');
+}
+
+void RPCClient::WriteRPCJson(std::string& out, Bytes const& val) { WriteRPCJson(out, BytesToHex(val)); }
+
+void RPCClient::WriteRPCJson(std::string& out, bool val) { out.append(val ? "true" : "false"); }
+
+void RPCClient::WriteRPCJson(std::string& out, double val) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.17g", val);
+    out.append(buf);
+}
+
+void RPCClient::WriteRPCJson(std::string& out, Outpoint const& val) {
+    out.append(R"({"txid":)");
+    WriteRPCJson(out, val.txid);
+    out.append(R"(,"vout":)");
+    WriteRPCJson(out, val.vout);
+    out.push_back('}');
+}
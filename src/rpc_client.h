@@ -6,8 +6,18 @@
 #include <json/value.h>
 #include <json/reader.h>
 
+#include <array>
+#include <atomic>
+#include <charconv>
 #include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
 #include "http_client.h"
 
@@ -23,6 +33,12 @@ public:
     explicit NetError(char const* msg) : Error(msg) {}
 };
 
+/// The connection to the node cannot be made, the request has not reached it and can be sent to another node
+class ConnectError : public NetError {
+public:
+    explicit ConnectError(char const* msg) : NetError(msg) {}
+};
+
 class RPCError : public Error {
 public:
     RPCError(int code, std::string msg) : Error(msg.c_str()), m_code(code), m_msg(std::move(msg)) {}
@@ -36,110 +52,293 @@ private:
 
 class RPCClient {
 public:
+    /// Satoshis of one BHD
+    static const int64_t COIN = 100000000;
+
     struct Result {
         Json::Value result;
         std::string error;
         int id;
     };
 
+    /// The url and the credentials of one btchd node
+    struct Backend {
+        std::string url;
+        std::string user;
+        std::string passwd;
+    };
+
+    /// Read the credentials of the backend from the `.cookie` of the node, `std::runtime_error` is thrown on failure
+    static Backend MakeCookieBackend(std::string url, std::string const& cookie_path_str);
+
     RPCClient(bool no_proxy, std::string url, std::string const& cookie_path_str = "");
 
     RPCClient(bool no_proxy, std::string url, std::string user, std::string passwd);
 
+    /**
+     * Each call is routed to the healthy backend with the lowest latency weighted by its calls in flight. A backend
+     * which cannot be connected is marked unhealthy and the call fails over to the next one, any other failure is
+     * thrown since the node might have run the call already.
+     */
+    RPCClient(bool no_proxy, std::vector<Backend> backends);
+
+    std::size_t NumBackends() const { return m_nodes.size(); }
+
+    Backend const& GetBackend(std::size_t index) const { return m_nodes[index]->backend; }
+
+    /**
+     * Check every backend with `getblockchaininfo` and `getwalletinfo`, a backend is unhealthy while it cannot be
+     * reached, is still in the initial block download or its wallet is locked. It blocks on RPC.
+     */
+    void ProbeBackends();
+
+    /// Let curl print the traffic of the connections which are opened from now on
+    void SetCurlVerbose(bool verbose) { m_curl_verbose = verbose; }
+
     std::string SendToAddress(std::string const& address, uint64_t amount);
 
+    /// Pay all addresses in one transaction, returns the txid
+    std::string SendMany(std::map<std::string, uint64_t> const& amounts);
+
+    /// An output of a transaction
+    struct Outpoint {
+        std::string txid;
+        int vout;
+
+        bool operator<(Outpoint const& rhs) const { return std::tie(txid, vout) < std::tie(rhs.txid, rhs.vout); }
+    };
+
+    /// An unspent output of the wallet, `amount` is in satoshis
+    struct Unspent {
+        Outpoint outpoint;
+        std::string address;
+        std::string label;
+        int64_t amount;
+        int confirmations;
+        bool spendable;
+    };
+
+    /// Pay the amounts which are formatted by `FormatAmount`, returns the txid
+    std::string SendMany(std::map<std::string, std::string> const& amounts);
+
+    std::vector<Unspent> ListUnspent(int min_conf, int max_conf = 9999999);
+
+    /// Several new addresses of the wallet with the label, they are requested in one batch
+    std::vector<std::string> GetNewAddresses(std::string const& label, int num);
+
+    /// Returns the hex of the unsigned transaction, the amounts of the outputs are formatted by `FormatAmount`
+    std::string CreateRawTransaction(
+            std::vector<Outpoint> const& inputs, std::map<std::string, std::string> const& outputs);
+
+    /// Returns the hex of the signed transaction, `Error` is thrown when the wallet cannot sign all inputs
+    std::string SignRawTransactionWithWallet(std::string const& hex);
+
+    /// Broadcast the signed transaction, returns the txid
+    std::string SendRawTransaction(std::string const& hex);
+
+    /// Format satoshis as the decimal amount accepted by the node, e.g. "10.00010000"
+    static std::string FormatAmount(int64_t amount);
+
+    /// The satoshis of a decimal amount returned by the node
+    static int64_t ParseAmount(Json::Value const& amount);
+
+    /**
+     * Several calls which are sent to the node in one JSON-RPC array by `SendBatch`, the responses are mapped back to
+     * the calls by their ids
+     */
+    class Batch {
+    public:
+        /// Queue a call, returns the id which is used to read the result after the batch is sent
+        template <typename... T>
+        int Add(std::string_view method_name, T&&... vals) {
+            int id = static_cast<int>(m_size++);
+            m_calls.push_back(id == 0 ? '[' : ',');
+            WriteRequest(m_calls, id, method_name, std::forward<T>(vals)...);
+            return id;
+        }
+
+        std::size_t Size() const { return m_size; }
+
+        /// The result of the call, `RPCError` is thrown when only this call is failed
+        Json::Value const& GetResult(int id) const;
+
+    private:
+        friend class RPCClient;
+
+        struct Response {
+            bool received{false};
+            Json::Value result;
+            int err_code{0};
+            std::string err_msg;
+        };
+
+        /// The serialized calls without the closing `]`
+        std::string m_calls;
+        std::size_t m_size{0};
+        std::vector<Response> m_responses;
+    };
+
+    /// Send all calls of the batch in one request, `NetError` or `Error` is thrown when the request itself is failed
+    void SendBatch(Batch& batch);
+
+    /**
+     * Append a compact JSON-RPC call to `out`, the fixed parts are copied from constant fragments so that only the
+     * params are serialized
+     */
+    template <typename... T>
+    static void WriteRequest(std::string& out, int id, std::string_view method_name, T&&... vals) {
+        out.append(R"({"jsonrpc":"2.0","id":)");
+        WriteRPCJson(out, id);
+        out.append(R"(,"method":")");
+        out.append(method_name);
+        out.append(R"(","params":[)");
+        WriteRPCJsonWithParams(out, std::forward<T>(vals)...);
+        out.append("]}");
+    }
+
+    /// Read the response of the call with `id`, `RPCError` is thrown for the error reported by the node
+    static Result ParseResponse(std::string_view data, int id);
+
 private:
-    void BuildRPCJson(Json::Value& params, std::string const& val);
+    static void WriteRPCJson(std::string& out, std::string_view val);
+
+    static void WriteRPCJson(std::string& out, char const* val) { WriteRPCJson(out, std::string_view(val)); }
 
-    void BuildRPCJson(Json::Value& params, Bytes const& val);
+    static void WriteRPCJson(std::string& out, Bytes const& val);
 
-    void BuildRPCJson(Json::Value& params, bool val);
+    static void WriteRPCJson(std::string& out, bool val);
+
+    static void WriteRPCJson(std::string& out, double val);
+
+    static void WriteRPCJson(std::string& out, Outpoint const& val);
+
+    template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    static void WriteRPCJson(std::string& out, T val) {
+        char buf[24];
+        auto res = std::to_chars(buf, buf + sizeof(buf), val);
+        out.append(buf, res.ptr);
+    }
 
     template <size_t N>
-    void BuildRPCJson(Json::Value& params, std::array<uint8_t, N> const& val) {
-        BuildRPCJson(params, BytesToHex(MakeBytes(val)));
+    static void WriteRPCJson(std::string& out, std::array<uint8_t, N> const& val) {
+        WriteRPCJson(out, MakeBytes(val));
     }
 
     template <typename T>
-    void BuildRPCJson(Json::Value& params, std::vector<T> const& val) {
-        Json::Value res(Json::arrayValue);
-        for (auto const& v : val) {
-            BuildRPCJson(res, v);
+    static void WriteRPCJson(std::string& out, std::vector<T> const& val) {
+        out.push_back('[');
+        for (auto i = val.begin(); i != val.end(); ++i) {
+            if (i != val.begin()) {
+                out.push_back(',');
+            }
+            WriteRPCJson(out, *i);
         }
-        params.append(res);
+        out.push_back(']');
     }
 
     template <typename T>
-    void BuildRPCJson(Json::Value& params, T&& val) {
-        params.append(std::forward<T>(val));
+    static void WriteRPCJson(std::string& out, std::map<std::string, T> const& val) {
+        out.push_back('{');
+        for (auto i = val.begin(); i != val.end(); ++i) {
+            if (i != val.begin()) {
+                out.push_back(',');
+            }
+            WriteRPCJson(out, std::string_view(i->first));
+            out.push_back(':');
+            WriteRPCJson(out, i->second);
+        }
+        out.push_back('}');
     }
 
-    void BuildRPCJsonWithParams(Json::Value& out_params);
+    static void WriteRPCJsonWithParams(std::string&) {}
 
     template <typename V, typename... T>
-    void BuildRPCJsonWithParams(Json::Value& outParams, V&& val, T&&... vals) {
-        BuildRPCJson(outParams, std::forward<V>(val));
-        BuildRPCJsonWithParams(outParams, std::forward<T>(vals)...);
+    static void WriteRPCJsonWithParams(std::string& out, V&& val, T&&... vals) {
+        WriteRPCJson(out, std::forward<V>(val));
+        if constexpr (sizeof...(vals) > 0) {
+            out.push_back(',');
+            WriteRPCJsonWithParams(out, std::forward<T>(vals)...);
+        }
     }
 
-    template <typename... T>
-    Result SendMethod(bool no_proxy, std::string const& method_name, T&&... vals) {
-        Json::Value root;
-        root["jsonrpc"] = "2.0";
-        root["method"] = method_name;
-        Json::Value params(Json::arrayValue);
-        BuildRPCJsonWithParams(params, std::forward<T>(vals)...);
-        root["params"] = params;
-        // Invoke curl
-        HTTPClient client(m_url, m_user, m_passwd, no_proxy);
-        std::string send_str = root.toStyledString();
-        PLOG_DEBUG << "sending: `" << send_str << "`";
-        bool succ;
-        int code;
-        std::string err_str;
-        std::tie(succ, code, err_str) = client.Send(send_str);
-        if (!succ) {
-            std::stringstream ss;
-            ss << "RPC command error `" << method_name << "`: " << err_str;
-            throw NetError(ss.str().c_str());
-        }
-        // Analyze the result
-        Bytes received_data = client.GetReceivedData();
-        if (received_data.empty()) {
-            throw NetError("empty result from RPC server");
-        }
-        char const* psz = reinterpret_cast<char const*>(received_data.data());
-        Json::Value res;
-        Json::CharReaderBuilder builder;
-        std::shared_ptr<Json::CharReader> reader(builder.newCharReader());
-        std::string errs;
-        if (!reader->parse(psz, psz + strlen(psz), &res, &errs)) {
-            throw Error("cannot parse the result from rpc server");
-        }
+    /// A backend with its idle clients and the state used by the routing
+    struct Node {
+        Backend backend;
+        std::atomic<int> in_flight{0};
+        std::mutex mtx;
+        std::vector<std::unique_ptr<HTTPClient>> idle_clients;
+        double latency_ms{0};  // EWMA of the finished requests, 0 until the first one
+        bool healthy{true};
+    };
 
-        // Build result and return
-        PLOG_DEBUG << "received: `" << res.toStyledString() << "`";
-        Result result;
-        if (res.isMember("result")) {
-            result.result = res["result"];
+    /// Borrows an idle client of the node and gives it back on destruction, the request is counted in flight meanwhile
+    class ClientHolder {
+    public:
+        ClientHolder(RPCClient& rpc, Node& node) : m_rpc(rpc), m_node(node), m_client(rpc.AcquireClient(node)) {
+            m_node.in_flight.fetch_add(1, std::memory_order_relaxed);
         }
-        if (res.isMember("error") && !res["error"].isNull()) {
-            Json::Value errorJson = res["error"];
-            int code = errorJson["code"].asInt();
-            std::string msg = errorJson["message"].asString();
-            throw RPCError(code, msg);
-        }
-        if (res.isMember("id") && res["id"].isInt()) {
-            result.id = res["id"].asInt();
+
+        ~ClientHolder() {
+            m_node.in_flight.fetch_sub(1, std::memory_order_relaxed);
+            m_rpc.ReleaseClient(m_node, std::move(m_client));
         }
-        return result;
+
+        HTTPClient* operator->() const { return m_client.get(); }
+
+    private:
+        RPCClient& m_rpc;
+        Node& m_node;
+        std::unique_ptr<HTTPClient> m_client;
+    };
+
+    std::unique_ptr<HTTPClient> AcquireClient(Node& node);
+
+    void ReleaseClient(Node& node, std::unique_ptr<HTTPClient> client);
+
+    /// The nodes in the order they are tried, the healthy ones by their score and then the unhealthy ones
+    std::vector<Node*> RouteNodes();
+
+    void RecordLatency(Node& node, double latency_ms);
+
+    /// An empty reason marks the node healthy, the changes are logged
+    void SetHealth(Node& node, std::string const& reason);
+
+    /**
+     * Route the request to a node and parse the response with a reader owned by the calling thread, `name` is only
+     * used by the error messages
+     */
+    Json::Value SendRequest(std::string_view name, std::string const& request);
+
+    /// Post the request to this node, `ConnectError` is thrown when the node cannot be connected
+    Json::Value PostRequest(Node& node, std::string_view name, std::string const& request);
+
+    /// Map the responses of a sent batch back to its calls
+    static void ReadBatch(Batch& batch, Json::Value const& res);
+
+    /// The request buffer of the calling thread, it is cleared but keeps its capacity
+    static std::string& RequestBuffer();
+
+    template <typename... T>
+    Result SendMethod(std::string_view method_name, T&&... vals) {
+        int id = m_next_id.fetch_add(1, std::memory_order_relaxed);
+        std::string& request = RequestBuffer();
+        WriteRequest(request, id, method_name, std::forward<T>(vals)...);
+        return CheckResponse(SendRequest(method_name, request), id);
     }
 
+    /// Take the result out of a parsed response, see `ParseResponse`
+    static Result CheckResponse(Json::Value res, int id);
+
 private:
+    static const std::size_t MAX_IDLE_CLIENTS = 16;
+
+    /// The weight of the latest request in the latency EWMA
+    static constexpr double LATENCY_ALPHA = 0.2;
+
     bool m_no_proxy;
-    std::string m_url;
-    std::string m_user;
-    std::string m_passwd;
+    bool m_curl_verbose{false};
+    std::vector<std::unique_ptr<Node>> m_nodes;
+    std::atomic<int> m_next_id{0};
 };
 
 #endif
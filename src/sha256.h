@@ -0,0 +1,34 @@
+#ifndef FAUCET_SHA256_H
+#define FAUCET_SHA256_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/// Plain SHA-256 (FIPS 180-4), only used for the checksums of addresses so it is kept small rather than fast
+class SHA256 {
+public:
+    static const std::size_t OUTPUT_SIZE = 32;
+
+    using Digest = std::array<uint8_t, OUTPUT_SIZE>;
+
+    SHA256();
+
+    SHA256& Write(uint8_t const* data, std::size_t size);
+
+    Digest Finalize();
+
+    /// SHA-256 applied twice, the checksum of Base58Check
+    static Digest Hash256(uint8_t const* data, std::size_t size);
+
+private:
+    void Transform(uint8_t const* chunk);
+
+private:
+    std::array<uint32_t, 8> m_state;
+    std::array<uint8_t, 64> m_buf;
+    std::size_t m_buf_size{0};
+    uint64_t m_total{0};
+};
+
+#endif
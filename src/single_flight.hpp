@@ -0,0 +1,54 @@
+#ifndef FAUCET_SINGLE_FLIGHT_HPP
+#define FAUCET_SINGLE_FLIGHT_HPP
+
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Deduplicates concurrent work on the same key. The first caller of `Join` becomes the leader and starts the work,
+ * the following callers are attached to it until the leader calls `Complete`, then all of them get the same result.
+ */
+template <typename Key, typename... Results>
+class SingleFlight {
+public:
+    using Callback = std::function<void(Results const&...)>;
+
+    /// Returns true when the caller is the leader and has to start the work and complete it
+    bool Join(Key const& key, Callback callback) {
+        std::lock_guard lock(m_mtx);
+        auto res = m_flights.try_emplace(key);
+        res.first->second.push_back(std::move(callback));
+        return res.second;
+    }
+
+    /// Finish the flight, the callbacks are invoked on the calling thread
+    void Complete(Key const& key, Results const&... results) {
+        std::vector<Callback> callbacks;
+        {
+            std::lock_guard lock(m_mtx);
+            auto i = m_flights.find(key);
+            if (i == std::end(m_flights)) {
+                return;
+            }
+            callbacks = std::move(i->second);
+            m_flights.erase(i);
+        }
+        for (auto const& callback : callbacks) {
+            callback(results...);
+        }
+    }
+
+    std::size_t Size() const {
+        std::lock_guard lock(m_mtx);
+        return m_flights.size();
+    }
+
+private:
+    mutable std::mutex m_mtx;
+    std::unordered_map<Key, std::vector<Callback>> m_flights;
+};
+
+#endif
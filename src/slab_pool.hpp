@@ -0,0 +1,248 @@
+#ifndef FAUCET_SLAB_POOL_HPP
+#define FAUCET_SLAB_POOL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Hands out blocks of one size which are carved from large slabs, freed blocks go back to a free list and are reused
+ * by the next allocation. The slabs are only released with the pool, so the pool settles at the peak number of blocks.
+ */
+class SlabPool {
+public:
+    SlabPool(std::size_t block_size, std::size_t blocks_per_slab)
+        : m_block_size(RoundUp(std::max(block_size, sizeof(Node)))), m_blocks_per_slab(blocks_per_slab) {}
+
+    ~SlabPool() {
+        for (void* slab : m_slabs) {
+            ::operator delete(slab);
+        }
+    }
+
+    SlabPool(SlabPool const&) = delete;
+
+    SlabPool& operator=(SlabPool const&) = delete;
+
+    void* Allocate() {
+        std::lock_guard lock(m_mtx);
+        if (m_free == nullptr) {
+            Grow();
+        }
+        Node* node = m_free;
+        m_free = node->next;
+        ++m_in_use;
+        return node;
+    }
+
+    void Deallocate(void* p) {
+        std::lock_guard lock(m_mtx);
+        Node* node = static_cast<Node*>(p);
+        node->next = m_free;
+        m_free = node;
+        --m_in_use;
+    }
+
+    std::size_t BlockSize() const { return m_block_size; }
+
+    /// How many blocks are allocated and not freed yet
+    std::size_t InUse() const {
+        std::lock_guard lock(m_mtx);
+        return m_in_use;
+    }
+
+private:
+    struct Node {
+        Node* next;
+    };
+
+    static std::size_t RoundUp(std::size_t size) {
+        std::size_t const align = alignof(std::max_align_t);
+        return (size + align - 1) / align * align;
+    }
+
+    void Grow() {
+        char* slab = static_cast<char*>(::operator new(m_block_size * m_blocks_per_slab));
+        m_slabs.push_back(slab);
+        // link the blocks in address order, the first block is handed out first
+        for (std::size_t i = m_blocks_per_slab; i > 0; --i) {
+            Node* node = reinterpret_cast<Node*>(slab + (i - 1) * m_block_size);
+            node->next = m_free;
+            m_free = node;
+        }
+    }
+
+    std::size_t m_block_size;
+    std::size_t m_blocks_per_slab;
+    mutable std::mutex m_mtx;
+    Node* m_free{nullptr};
+    std::size_t m_in_use{0};
+    std::vector<void*> m_slabs;
+};
+
+/// Takes a block from the pool and gives it back on destruction
+class SlabBlock {
+public:
+    explicit SlabBlock(SlabPool& pool) : m_pool(pool), m_p(pool.Allocate()) {}
+
+    ~SlabBlock() { m_pool.Deallocate(m_p); }
+
+    SlabBlock(SlabBlock const&) = delete;
+
+    SlabBlock& operator=(SlabBlock const&) = delete;
+
+    void* Get() const { return m_p; }
+
+private:
+    SlabPool& m_pool;
+    void* m_p;
+};
+
+/**
+ * An allocator whose single objects come from a `SlabPool` sized for `T`, with one pool for each type. It is meant for
+ * `std::allocate_shared`, which rebinds it to the type holding the object and its control block, so that type gets the
+ * pool and the blocks fit it exactly. Arrays come from the heap.
+ */
+template <typename T, std::size_t BlocksPerSlab>
+class SlabAllocator {
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = SlabAllocator<U, BlocksPerSlab>;
+    };
+
+    SlabAllocator() = default;
+
+    template <typename U>
+    SlabAllocator(SlabAllocator<U, BlocksPerSlab> const&) {}
+
+    T* allocate(std::size_t n) {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "the blocks are only aligned for std::max_align_t");
+        if (n == 1) {
+            return static_cast<T*>(GetPool().Allocate());
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        if (n == 1) {
+            GetPool().Deallocate(p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    static SlabPool& GetPool() {
+        static SlabPool pool(sizeof(T), BlocksPerSlab);
+        return pool;
+    }
+
+    template <typename U>
+    bool operator==(SlabAllocator<U, BlocksPerSlab> const&) const {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(SlabAllocator<U, BlocksPerSlab> const&) const {
+        return false;
+    }
+};
+
+/**
+ * Inline storage for the handler of one outstanding asynchronous operation, see `MakeAllocHandler`. A second
+ * allocation while the storage is taken falls back to the heap.
+ */
+class HandlerMemory {
+public:
+    HandlerMemory() = default;
+
+    HandlerMemory(HandlerMemory const&) = delete;
+
+    HandlerMemory& operator=(HandlerMemory const&) = delete;
+
+    void* Allocate(std::size_t size) {
+        if (!m_in_use && size <= sizeof(m_storage)) {
+            m_in_use = true;
+            return m_storage;
+        }
+        return ::operator new(size);
+    }
+
+    void Deallocate(void* p) {
+        if (p == m_storage) {
+            m_in_use = false;
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+private:
+    static std::size_t const STORAGE_SIZE = 256;
+
+    alignas(std::max_align_t) unsigned char m_storage[STORAGE_SIZE];
+    bool m_in_use{false};
+};
+
+template <typename T>
+class HandlerAllocator {
+public:
+    using value_type = T;
+
+    explicit HandlerAllocator(HandlerMemory& mem) : m_mem(&mem) {}
+
+    template <typename U>
+    HandlerAllocator(HandlerAllocator<U> const& other) : m_mem(other.m_mem) {}
+
+    T* allocate(std::size_t n) { return static_cast<T*>(m_mem->Allocate(n * sizeof(T))); }
+
+    void deallocate(T* p, std::size_t) { m_mem->Deallocate(p); }
+
+    template <typename U>
+    bool operator==(HandlerAllocator<U> const& rhs) const {
+        return m_mem == rhs.m_mem;
+    }
+
+    template <typename U>
+    bool operator!=(HandlerAllocator<U> const& rhs) const {
+        return m_mem != rhs.m_mem;
+    }
+
+private:
+    template <typename U>
+    friend class HandlerAllocator;
+
+    HandlerMemory* m_mem;
+};
+
+/// A completion handler whose associated allocator takes the operation's memory from a `HandlerMemory`
+template <typename Handler>
+class AllocHandler {
+public:
+    using allocator_type = HandlerAllocator<Handler>;
+
+    AllocHandler(HandlerMemory& mem, Handler handler) : m_mem(mem), m_handler(std::move(handler)) {}
+
+    allocator_type get_allocator() const noexcept { return allocator_type(m_mem); }
+
+    template <typename... Args>
+    void operator()(Args&&... args) {
+        m_handler(std::forward<Args>(args)...);
+    }
+
+private:
+    HandlerMemory& m_mem;
+    Handler m_handler;
+};
+
+template <typename Handler>
+AllocHandler<std::decay_t<Handler>> MakeAllocHandler(HandlerMemory& mem, Handler&& handler) {
+    return AllocHandler<std::decay_t<Handler>>(mem, std::forward<Handler>(handler));
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef FAUCET_TIMER_WHEEL_HPP
+#define FAUCET_TIMER_WHEEL_HPP
+
+#include <asio.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * Deadlines of many objects driven by one `steady_timer`. The entries are linked into the slot of the tick they
+ * expire on, so scheduling and cancelling are O(1) and never allocate. A deadline fires up to one tick late.
+ */
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// The intrusive hook of an object with a deadline, the owner must cancel it before it is destroyed
+    class Entry {
+    public:
+        Entry() = default;
+
+        Entry(Entry const&) = delete;
+
+        Entry& operator=(Entry const&) = delete;
+
+    protected:
+        ~Entry() = default;
+
+        /**
+         * Invoked on the thread of the wheel with its lock held, so the owner can neither be destroyed nor schedule
+         * again meanwhile. It must return quickly, usually by posting the real work to the owner's executor.
+         */
+        virtual void OnExpired() = 0;
+
+    private:
+        friend class TimerWheel;
+
+        Entry* m_prev{nullptr};
+        Entry* m_next{nullptr};
+        uint64_t m_expire_tick{0};
+        bool m_linked{false};
+    };
+
+    TimerWheel(asio::io_context& ioc, Clock::duration tick, std::size_t num_slots)
+        : m_timer(ioc), m_tick(tick), m_slots(num_slots), m_start(Clock::now()) {}
+
+    ~TimerWheel() { m_timer.cancel(); }
+
+    TimerWheel(TimerWheel const&) = delete;
+
+    TimerWheel& operator=(TimerWheel const&) = delete;
+
+    void Start() { WaitNext(); }
+
+    /// Expire the entry after `timeout`, an earlier deadline of the entry is replaced
+    void Schedule(Entry& entry, Clock::duration timeout) {
+        std::lock_guard lock(m_mtx);
+        Unlink(entry);
+        uint64_t expire_tick = (Clock::now() - m_start + timeout + m_tick - Clock::duration(1)) / m_tick;
+        entry.m_expire_tick = std::max(expire_tick, m_current_tick + 1);
+        Entry*& head = m_slots[entry.m_expire_tick % m_slots.size()];
+        entry.m_prev = nullptr;
+        entry.m_next = head;
+        if (head != nullptr) {
+            head->m_prev = &entry;
+        }
+        head = &entry;
+        entry.m_linked = true;
+    }
+
+    void Cancel(Entry& entry) {
+        std::lock_guard lock(m_mtx);
+        Unlink(entry);
+    }
+
+private:
+    void WaitNext() {
+        m_timer.expires_after(m_tick);
+        m_timer.async_wait([this](std::error_code const& ec) {
+            if (ec) {
+                return;
+            }
+            Advance();
+            WaitNext();
+        });
+    }
+
+    void Advance() {
+        std::lock_guard lock(m_mtx);
+        uint64_t now_tick = (Clock::now() - m_start) / m_tick;
+        // a late wakeup catches up, but every slot only needs to be visited once
+        uint64_t num_slots = m_slots.size();
+        uint64_t first_tick = std::max(m_current_tick + 1, now_tick >= num_slots ? now_tick - num_slots + 1 : 0);
+        for (uint64_t tick = first_tick; tick <= now_tick; ++tick) {
+            Entry* entry = m_slots[tick % m_slots.size()];
+            while (entry != nullptr) {
+                Entry* next = entry->m_next;
+                // the entries of later rounds share the slot
+                if (entry->m_expire_tick <= now_tick) {
+                    Unlink(*entry);
+                    entry->OnExpired();
+                }
+                entry = next;
+            }
+        }
+        m_current_tick = std::max(m_current_tick, now_tick);
+    }
+
+    void Unlink(Entry& entry) {
+        if (!entry.m_linked) {
+            return;
+        }
+        if (entry.m_prev != nullptr) {
+            entry.m_prev->m_next = entry.m_next;
+        } else {
+            m_slots[entry.m_expire_tick % m_slots.size()] = entry.m_next;
+        }
+        if (entry.m_next != nullptr) {
+            entry.m_next->m_prev = entry.m_prev;
+        }
+        entry.m_prev = entry.m_next = nullptr;
+        entry.m_linked = false;
+    }
+
+    asio::steady_timer m_timer;
+    Clock::duration m_tick;
+    std::mutex m_mtx;
+    std::vector<Entry*> m_slots;
+    Clock::time_point m_start;
+    uint64_t m_current_tick{0};
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define UTILS_HPP
 
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <regex>
 #include <algorithm>
@@ -44,6 +45,15 @@ inline std::string TrimLeftString(std::string const& str) {
     return str.substr(p);
 }
 
+inline std::string_view TrimString(std::string_view str) {
+    auto b = str.find_first_not_of(" \t");
+    if (b == std::string_view::npos) {
+        return {};
+    }
+    auto e = str.find_last_not_of(" \t");
+    return str.substr(b, e - b + 1);
+}
+
 inline bool Expand1EnvPath(std::string const& path, std::string& out_expanded) {
     std::regex r("\\$\\w+");
     std::sregex_iterator begin(std::begin(path), std::end(path), r), end;
@@ -80,4 +90,16 @@ inline std::string ToLowerCase(std::string const& str) {
     return res;
 }
 
+inline bool EqualsIgnoreCase(std::string_view lhs, std::string_view rhs) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < lhs.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(lhs[i])) != std::tolower(static_cast<unsigned char>(rhs[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
 #endif
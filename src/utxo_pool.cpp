@@ -0,0 +1,162 @@
+#include "utxo_pool.h"
+
+#include <algorithm>
+
+#include <plog/Log.h>
+
+UtxoPool::UtxoPool(asio::io_context& ioc, asio::thread_pool& rpc_pool, RPCClient& rpc, Options opts)
+        : m_timer(asio::make_strand(ioc)), m_rpc_pool(rpc_pool), m_rpc(rpc), m_opts(std::move(opts)) {}
+
+void UtxoPool::Start() { ScheduleRefill(std::chrono::steady_clock::duration::zero()); }
+
+bool UtxoPool::Pay(std::vector<std::string> const& addresses, int64_t amount, std::string& out_txid) {
+    std::vector<Outpoint> coins;
+    if (amount > m_opts.coin_value || !Reserve(addresses.size(), coins)) {
+        RequestRefill(true);
+        return false;
+    }
+    if (Available() < m_opts.target_size / 2) {
+        RequestRefill(true);
+    }
+    std::map<std::string, std::string> outputs;
+    for (auto const& address : addresses) {
+        outputs[address] = RPCClient::FormatAmount(amount);
+    }
+    std::string signed_hex;
+    try {
+        signed_hex = m_rpc.SignRawTransactionWithWallet(m_rpc.CreateRawTransaction(coins, outputs));
+    } catch (std::exception const&) {
+        // nothing is broadcast, the coins are still good
+        Release(coins, false);
+        throw;
+    }
+    try {
+        out_txid = m_rpc.SendRawTransaction(signed_hex);
+    } catch (RPCError const&) {
+        // rejected by the node, the coins are still unspent unless the next listing drops them
+        Release(coins, false);
+        RequestRefill(true);
+        throw;
+    } catch (std::exception const&) {
+        // the transaction might have been broadcast, the coins are parked until the listings tell
+        Release(coins, true);
+        throw;
+    }
+    Release(coins, true);
+    return true;
+}
+
+std::size_t UtxoPool::Available() const {
+    std::lock_guard lock(m_mtx);
+    return m_available.size();
+}
+
+void UtxoPool::ScheduleRefill(std::chrono::steady_clock::duration delay) {
+    m_timer.expires_after(delay);
+    m_timer.async_wait([this](std::error_code const& ec) {
+        if (ec == asio::error::operation_aborted) {
+            return;
+        }
+        RequestRefill(false);
+    });
+}
+
+void UtxoPool::RequestRefill(bool early) {
+    {
+        std::lock_guard lock(m_mtx);
+        if (m_refilling || (early && std::chrono::steady_clock::now() - m_last_refill < MIN_REFILL_GAP)) {
+            return;
+        }
+        m_refilling = true;
+    }
+    asio::post(m_rpc_pool, [this]() {
+        Refill();
+        asio::post(m_timer.get_executor(), [this]() { ScheduleRefill(m_opts.refill_interval); });
+    });
+}
+
+void UtxoPool::Refill() {
+    try {
+        auto unspents = m_rpc.ListUnspent(0);
+        std::size_t num_pending{0};
+        std::set<Outpoint> listed;
+        std::vector<Outpoint> available;
+        for (auto const& unspent : unspents) {
+            if (unspent.label != m_opts.label || unspent.amount != m_opts.coin_value || !unspent.spendable) {
+                continue;
+            }
+            listed.insert(unspent.outpoint);
+            if (unspent.confirmations < m_opts.min_conf) {
+                ++num_pending;
+            } else {
+                available.push_back(unspent.outpoint);
+            }
+        }
+        std::size_t num_coins;
+        {
+            std::lock_guard lock(m_mtx);
+            // the spent coins are forgotten once the wallet stops listing them, a coin which is still listed after
+            // several refills was never spent and can be used again
+            for (auto i = std::begin(m_spent); i != std::end(m_spent);) {
+                if (!listed.count(i->first)) {
+                    i = m_spent.erase(i);
+                } else if (++i->second >= SPENT_MAX_LISTINGS) {
+                    PLOG_INFO << "utxo pool: coin " << i->first.txid << ":" << i->first.vout
+                              << " is still unspent, it is used again";
+                    i = m_spent.erase(i);
+                } else {
+                    ++i;
+                }
+            }
+            available.erase(std::remove_if(std::begin(available), std::end(available),
+                                    [this](Outpoint const& coin) {
+                                        return m_reserved.count(coin) || m_spent.count(coin);
+                                    }),
+                    std::end(available));
+            m_available = std::move(available);
+            num_coins = m_available.size() + m_reserved.size() + num_pending;
+        }
+        PLOG_DEBUG << "utxo pool: " << Available() << " available, " << num_pending << " pending";
+        // large deficits are split into several transactions of at most `max_fanout` outputs
+        while (num_coins < m_opts.target_size) {
+            std::size_t num = std::min(m_opts.target_size - num_coins, m_opts.max_fanout);
+            auto addresses = m_rpc.GetNewAddresses(m_opts.label, static_cast<int>(num));
+            std::map<std::string, std::string> amounts;
+            for (auto const& address : addresses) {
+                amounts[address] = RPCClient::FormatAmount(m_opts.coin_value);
+            }
+            std::string txid = m_rpc.SendMany(amounts);
+            PLOG_INFO << "utxo pool: tx=" << txid << ", fanned out " << num << " coin(s) of "
+                      << RPCClient::FormatAmount(m_opts.coin_value);
+            num_coins += num;
+        }
+    } catch (std::exception const& e) {
+        PLOG_ERROR << "Cannot refill the utxo pool: " << e.what();
+    }
+    std::lock_guard lock(m_mtx);
+    m_refilling = false;
+    m_last_refill = std::chrono::steady_clock::now();
+}
+
+bool UtxoPool::Reserve(std::size_t num, std::vector<Outpoint>& out_coins) {
+    std::lock_guard lock(m_mtx);
+    if (m_available.size() < num) {
+        return false;
+    }
+    out_coins.assign(m_available.end() - num, m_available.end());
+    m_available.resize(m_available.size() - num);
+    m_reserved.insert(std::begin(out_coins), std::end(out_coins));
+    return true;
+}
+
+void UtxoPool::Release(std::vector<Outpoint> const& coins, bool spent) {
+    std::lock_guard lock(m_mtx);
+    for (auto const& coin : coins) {
+        m_reserved.erase(coin);
+        if (spent) {
+            m_spent.emplace(coin, 0);
+        } else {
+            m_available.push_back(coin);
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef FAUCET_UTXO_POOL_H
+#define FAUCET_UTXO_POOL_H
+
+#include <asio.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "rpc_client.h"
+
+/**
+ * Keeps `target_size` confirmed coins of `coin_value` in the wallet, each of them pays exactly one address and the
+ * rest of the coin is the fee. The payouts are built from these coins with raw transactions, so they neither wait for
+ * the coin selection of the wallet nor chain on the change of each other, and any number of them can run concurrently.
+ *
+ * The pool is refilled every `refill_interval` on the RPC pool, and earlier when it drops below half of the target:
+ * the coins are listed by `listunspent` and the missing ones are fanned out to new labeled addresses by `sendmany`.
+ *
+ * The coins of a payout rejected by the node go back to the pool. When the broadcast fails on the network the payout
+ * might have been made, so its coins are held back until the wallet stops listing them, or for at most
+ * `SPENT_MAX_LISTINGS` refills which still list them.
+ */
+class UtxoPool {
+public:
+    struct Options {
+        std::size_t target_size{100};
+        int64_t coin_value{0};  // satoshis, the payout amount plus the fee
+        int min_conf{1};
+        std::size_t max_fanout{100};  // outputs of one fan-out transaction
+        std::chrono::seconds refill_interval{30};
+        std::string label{"faucet-pool"};
+    };
+
+    UtxoPool(asio::io_context& ioc, asio::thread_pool& rpc_pool, RPCClient& rpc, Options opts);
+
+    /// Schedule the first refill
+    void Start();
+
+    /**
+     * Pay `amount` satoshis to each address from the coins of the pool, it blocks on RPC and must run on the RPC pool.
+     * Any failure is thrown.
+     *
+     * @return false when there are not enough coins, nothing is sent then
+     */
+    bool Pay(std::vector<std::string> const& addresses, int64_t amount, std::string& out_txid);
+
+    /// The number of confirmed coins which can be used now
+    std::size_t Available() const;
+
+private:
+    static constexpr std::chrono::seconds MIN_REFILL_GAP{1};
+
+    /// How many refills a spent coin can still be listed by the wallet before it is taken as unspent
+    static const int SPENT_MAX_LISTINGS = 3;
+
+    using Outpoint = RPCClient::Outpoint;
+
+    void ScheduleRefill(std::chrono::steady_clock::duration delay);
+
+    /// Post a refill to the RPC pool unless one is running, an early refill also waits for `MIN_REFILL_GAP`
+    void RequestRefill(bool early);
+
+    void Refill();
+
+    bool Reserve(std::size_t num, std::vector<Outpoint>& out_coins);
+
+    /// Give the coins back when they are not sent, otherwise they are remembered as spent
+    void Release(std::vector<Outpoint> const& coins, bool spent);
+
+private:
+    asio::steady_timer m_timer;
+    asio::thread_pool& m_rpc_pool;
+    RPCClient& m_rpc;
+    Options m_opts;
+    mutable std::mutex m_mtx;
+    std::vector<Outpoint> m_available;
+    std::set<Outpoint> m_reserved;
+    // spent by our payouts but might still be listed until the wallet sees the transactions, with the number of
+    // refills which have listed them since
+    std::map<Outpoint, int> m_spent;
+    bool m_refilling{false};
+    std::chrono::steady_clock::time_point m_last_refill;
+};
+
+#endif
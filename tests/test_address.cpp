@@ -0,0 +1,117 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "address.h"
+#include "sha256.h"
+
+namespace {
+
+std::string Hex(SHA256::Digest const& digest) {
+    std::string res;
+    char buf[3];
+    for (uint8_t byte : digest) {
+        snprintf(buf, sizeof(buf), "%02x", byte);
+        res += buf;
+    }
+    return res;
+}
+
+std::string HexOfSHA256(std::string const& str) {
+    return Hex(SHA256().Write(reinterpret_cast<uint8_t const*>(str.data()), str.size()).Finalize());
+}
+
+AddressType Validate(std::string_view address) { return ValidateAddress(address, AddressParams::Testnet3()); }
+
+}  // namespace
+
+TEST_CASE("sha256 matches the FIPS 180-4 vectors", "[address]") {
+    CHECK(HexOfSHA256("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    CHECK(HexOfSHA256("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    CHECK(HexOfSHA256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    CHECK(HexOfSHA256(std::string(1000000, 'a')) ==
+            "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    // written in pieces across the block boundaries
+    SHA256 sha;
+    std::string million(1000000, 'a');
+    for (std::size_t i = 0; i < million.size(); i += 777) {
+        sha.Write(reinterpret_cast<uint8_t const*>(million.data()) + i, std::min<std::size_t>(777, million.size() - i));
+    }
+    CHECK(Hex(sha.Finalize()) == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TEST_CASE("valid testnet segwit addresses", "[address]") {
+    CHECK(Validate("tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx") == AddressType::WitnessV0KeyHash);
+    CHECK(Validate("TB1QW508D6QEJXTDG4Y5R3ZARVARY0C5XW7KXPJZSX") == AddressType::WitnessV0KeyHash);
+    CHECK(Validate("tb1qrp33g0q5c5txsp9arysrx4k6zdkfs4nce4xj0gdcccefvpysxf3q0sl5k7") ==
+            AddressType::WitnessV0ScriptHash);
+    CHECK(Validate("tb1qqqqqp399et2xygdj5xreqhjjvcmzhxw4aywxecjdzew6hylgvsesrxh6hy") ==
+            AddressType::WitnessV0ScriptHash);
+    CHECK(Validate("tb1pqqqqp399et2xygdj5xreqhjjvcmzhxw4aywxecjdzew6hylgvsesf3hn0c") == AddressType::WitnessUnknown);
+}
+
+TEST_CASE("invalid testnet segwit addresses", "[address]") {
+    // BIP173 and BIP350
+    CHECK(Validate("tc1p0xlxvlhemja6c4dqv22uapctqupfhlxm9h8z3k2e72q4k9hcz7vq5zuyut") == AddressType::Invalid);
+    CHECK(Validate("tb1q0xlxvlhemja6c4dqv22uapctqupfhlxm9h8z3k2e72q4k9hcz7vq24jc47") == AddressType::Invalid);
+    CHECK(Validate("tb1z0xlxvlhemja6c4dqv22uapctqupfhlxm9h8z3k2e72q4k9hcz7vqglt7rf") == AddressType::Invalid);
+    CHECK(Validate("tb1p0xlxvlhemja6c4dqv22uapctqupfhlxm9h8z3k2e72q4k9hcz7vq47Zagq") == AddressType::Invalid);
+    CHECK(Validate("tb1qrp33g0q5c5txsp9arysrx4k6zdkfs4nce4xj0gdcccefvpysxf3q0sL5k7") == AddressType::Invalid);
+    CHECK(Validate("tb1pw508d6qejxtdg4y5r3zarqfsj6c3") == AddressType::Invalid);
+    CHECK(Validate("tb1qrp33g0q5c5txsp9arysrx4k6zdkfs4nce4xj0gdcccefvpysxf3pjxtptv") == AddressType::Invalid);
+    CHECK(Validate("tb1gmk9yu") == AddressType::Invalid);
+    // mainnet and a broken checksum
+    CHECK(Validate("bc1qw508d6qejxtdg4y5r3zarvary0c5xw7kv8f3t4") == AddressType::Invalid);
+    CHECK(Validate("tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsy") == AddressType::Invalid);
+}
+
+TEST_CASE("base58 testnet addresses", "[address]") {
+    CHECK(Validate("mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn") == AddressType::PubKeyHash);
+    CHECK(Validate("n3GNqMveyvaPvUbH469vDRadqpJMPc84JA") == AddressType::PubKeyHash);
+    CHECK(Validate("2MzQwSSnBHWHqSAqtTVQ6v47XtaisrJa1Vc") == AddressType::ScriptHash);
+    CHECK(Validate("2N2JD6wb56AfK4tfmM6PwdVmoYk2dCKf4Br") == AddressType::ScriptHash);
+    // mainnet prefixes, a changed character and a wrong case
+    CHECK(Validate("1BvBMSEYstWetqTFn5Au4m4GFg7xJaNVN2") == AddressType::Invalid);
+    CHECK(Validate("3J98t1WpEZ73CNmQviecrnyiWrnqRhWNLy") == AddressType::Invalid);
+    CHECK(Validate("mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfm") == AddressType::Invalid);
+    CHECK(Validate("MIPCBBFG9GMICH81KJ8TQQDGOZUB1ZJRFN") == AddressType::Invalid);
+    CHECK(Validate("") == AddressType::Invalid);
+}
+
+TEST_CASE("segwit addresses are normalized to lower case", "[address]") {
+    std::string address = "TB1QW508D6QEJXTDG4Y5R3ZARVARY0C5XW7KXPJZSX";
+    NormalizeAddress(address, Validate(address));
+    CHECK(address == "tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx");
+    address = "TB1PQQQQP399ET2XYGDJ5XREQHJJVCMZHXW4AYWXECJDZEW6HYLGVSESF3HN0C";
+    NormalizeAddress(address, Validate(address));
+    CHECK(address == "tb1pqqqqp399et2xygdj5xreqhjjvcmzhxw4aywxecjdzew6hylgvsesf3hn0c");
+    // base58 is case-sensitive
+    address = "mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn";
+    NormalizeAddress(address, Validate(address));
+    CHECK(address == "mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn");
+}
+
+TEST_CASE("encoded addresses are validated", "[address]") {
+    std::mt19937 rng(20261016);
+    for (int i = 0; i < 1000; ++i) {
+        int version = static_cast<int>(rng() % 17);
+        std::size_t size = version == 0 ? (rng() % 2 ? 20 : 32) : 2 + rng() % 39;
+        Bytes program(size);
+        for (auto& byte : program) {
+            byte = static_cast<uint8_t>(rng());
+        }
+        AddressType expected = AddressType::WitnessUnknown;
+        if (version == 0) {
+            expected = size == 20 ? AddressType::WitnessV0KeyHash : AddressType::WitnessV0ScriptHash;
+        }
+        REQUIRE(Validate(EncodeSegwitAddress("tb", version, program)) == expected);
+        Bytes hash(program.begin(), program.begin() + std::min<std::size_t>(program.size(), 20));
+        hash.resize(20);
+        REQUIRE(Validate(EncodeBase58Check(111, hash)) == AddressType::PubKeyHash);
+        REQUIRE(Validate(EncodeBase58Check(196, hash)) == AddressType::ScriptHash);
+    }
+}
@@ -0,0 +1,156 @@
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <string_view>
+
+#include "faucet_service.hpp"
+
+namespace {
+
+std::string const BODY = R"({"address":"tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx"})";
+
+std::string MakeRequest(std::string const& body = BODY) {
+    return "POST /fund HTTP/1.1\r\n"
+           "Host: faucet.example.org\r\n"
+           "Content-Type: application/json\r\n"
+           "Content-Length: " +
+           std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+void CheckRequest(SimpleHttpMessageParser const& parser, std::string const& body = BODY) {
+    CHECK(parser.GetState() == SimpleHttpMessageParser::State::Done);
+    CHECK(parser.ReadMethodType() == "POST");
+    CHECK(parser.ReadTarget() == "/fund");
+    CHECK(parser.ReadVersion() == "HTTP/1.1");
+    std::string_view content_type;
+    REQUIRE(parser.ReadHeader("content-type", content_type));
+    CHECK(content_type == "application/json");
+    CHECK(parser.ReadBody() == body);
+}
+
+}  // namespace
+
+TEST_CASE("a whole request is parsed in one write", "[http]") {
+    SimpleHttpMessageParser parser;
+    std::string req = MakeRequest();
+    REQUIRE(parser.Write(req.data(), req.size()));
+    CheckRequest(parser);
+    CHECK(parser.KeepAlive());
+}
+
+TEST_CASE("a request split at any offset gives the same result", "[http]") {
+    std::string req = MakeRequest();
+    for (std::size_t split = 0; split <= req.size(); ++split) {
+        CAPTURE(split);
+        SimpleHttpMessageParser parser;
+        bool done = parser.Write(req.data(), split);
+        CHECK(done == (split == req.size()));
+        CHECK_FALSE(parser.IsError());
+        if (!done) {
+            REQUIRE(parser.Write(req.data() + split, req.size() - split));
+        }
+        CheckRequest(parser);
+    }
+}
+
+TEST_CASE("a request written byte by byte is parsed", "[http]") {
+    std::string req = MakeRequest();
+    SimpleHttpMessageParser parser;
+    for (std::size_t i = 0; i + 1 < req.size(); ++i) {
+        REQUIRE_FALSE(parser.Write(req.data() + i, 1));
+    }
+    REQUIRE(parser.Write(req.data() + req.size() - 1, 1));
+    CheckRequest(parser);
+}
+
+TEST_CASE("pipelined requests split at any offset are parsed in order", "[http]") {
+    std::string other_body = R"({"address":"tb1qrp33g0q5c5txsp9arysrx4k6zdkfs4nce4xj0gdcccefvpysxf3q0sl5k7"})";
+    std::string stream = MakeRequest() + MakeRequest(other_body);
+    for (std::size_t split = 0; split <= stream.size(); ++split) {
+        CAPTURE(split);
+        SimpleHttpMessageParser parser;
+        bool done = parser.Write(stream.data(), split);
+        if (!done) {
+            REQUIRE(parser.Write(stream.data() + split, stream.size() - split));
+            CheckRequest(parser);
+            CHECK(parser.Next());
+        } else {
+            CheckRequest(parser);
+            if (!parser.Next()) {
+                REQUIRE(parser.Write(stream.data() + split, stream.size() - split));
+            }
+        }
+        CheckRequest(parser, other_body);
+        CHECK_FALSE(parser.Next());
+        CHECK_FALSE(parser.HasPendingBytes());
+    }
+}
+
+TEST_CASE("leading empty lines and bare line feeds are accepted", "[http]") {
+    SimpleHttpMessageParser parser;
+    std::string req = "\r\n\nGET /metrics HTTP/1.0\nConnection: keep-alive\n\n";
+    REQUIRE(parser.Write(req.data(), req.size()));
+    CHECK(parser.ReadMethodType() == "GET");
+    CHECK(parser.ReadTarget() == "/metrics");
+    CHECK(parser.ReadBody().empty());
+    CHECK(parser.KeepAlive());
+}
+
+TEST_CASE("connection semantics follow the http version", "[http]") {
+    SimpleHttpMessageParser parser;
+    std::string req = "GET / HTTP/1.1\r\nConnection: Close\r\n\r\n";
+    REQUIRE(parser.Write(req.data(), req.size()));
+    CHECK_FALSE(parser.KeepAlive());
+    parser.Next();
+    req = "GET / HTTP/1.0\r\n\r\n";
+    REQUIRE(parser.Write(req.data(), req.size()));
+    CHECK_FALSE(parser.KeepAlive());
+}
+
+TEST_CASE("many small header lines are limited by the total header size", "[http]") {
+    SimpleHttpMessageParser parser;
+    std::string req = "GET / HTTP/1.1\r\n";
+    REQUIRE_FALSE(parser.Write(req.data(), req.size()));
+    std::string line = "X-Pad: " + std::string(50, 'a') + "\r\n";
+    std::size_t written = req.size();
+    // the lines are sent one by one, so each of them is far below the limit
+    while (written <= MAX_HEADER_SIZE && !parser.IsError()) {
+        parser.Write(line.data(), line.size());
+        written += line.size();
+    }
+    CHECK(parser.IsError());
+    CHECK(written <= MAX_HEADER_SIZE + line.size());
+}
+
+TEST_CASE("the number of headers is limited", "[http]") {
+    SimpleHttpMessageParser parser;
+    std::string req = "GET / HTTP/1.1\r\n";
+    for (std::size_t i = 0; i <= MAX_HEADERS; ++i) {
+        req += "A: b\r\n";
+    }
+    req += "\r\n";
+    CHECK_FALSE(parser.Write(req.data(), req.size()));
+    CHECK(parser.IsError());
+}
+
+TEST_CASE("a single header line without an end is limited", "[http]") {
+    SimpleHttpMessageParser parser;
+    std::string req = "GET / HTTP/1.1\r\nX-Long: " + std::string(MAX_HEADER_SIZE, 'a');
+    CHECK_FALSE(parser.Write(req.data(), req.size()));
+    CHECK(parser.IsError());
+}
+
+TEST_CASE("invalid messages are errors", "[http]") {
+    std::string const reqs[] = {
+            "GARBAGE\r\n\r\n",
+            "POST / HTTP/1.1\r\nNoColon\r\n\r\n",
+            "POST / HTTP/1.1\r\nContent-Length: 12x\r\n\r\n",
+            "POST / HTTP/1.1\r\nContent-Length: " + std::to_string(MAX_BODY_SIZE + 1) + "\r\n\r\n",
+    };
+    for (auto const& req : reqs) {
+        CAPTURE(req);
+        SimpleHttpMessageParser parser;
+        CHECK_FALSE(parser.Write(req.data(), req.size()));
+        CHECK(parser.IsError());
+    }
+}
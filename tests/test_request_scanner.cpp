@@ -0,0 +1,201 @@
+#include <catch2/catch.hpp>
+
+#include <json/json.h>
+
+#include <memory>
+#include <random>
+#include <string>
+
+#include "request_scanner.hpp"
+
+namespace {
+
+using Result = RequestScanner::Result;
+
+/// Random json-like bodies, mostly valid requests with some noise in them
+class BodyGenerator {
+public:
+    explicit BodyGenerator(uint32_t seed) : m_rng(seed) {}
+
+    std::string Next() {
+        std::string body;
+        AppendWhitespace(body);
+        if (Chance(90)) {
+            AppendObject(body, 0, true);
+        } else {
+            AppendValue(body, 0);
+        }
+        AppendWhitespace(body);
+        if (Chance(30)) {
+            Mutate(body);
+        }
+        return body;
+    }
+
+private:
+    bool Chance(int percent) { return static_cast<int>(m_rng() % 100) < percent; }
+
+    std::size_t Pick(std::size_t n) { return m_rng() % n; }
+
+    void AppendWhitespace(std::string& out) {
+        static char const WHITESPACES[] = {' ', '\t', '\n', '\r'};
+        while (Chance(20)) {
+            out.push_back(WHITESPACES[Pick(4)]);
+        }
+    }
+
+    void AppendString(std::string& out) {
+        static char const* const PIECES[] = {"tb1q", "w508d6", "address", "\\\"", "\\\\", "\\/", "\\n", "\\t",
+                "\\u0041", "\\u00e9", "\\u4e2d", "\\ud83d\\ude00", "\\ud800", "\xc3\xa9", " ", "\\x", "\x01", "'"};
+        out.push_back('"');
+        std::size_t n = Pick(6);
+        for (std::size_t i = 0; i < n; ++i) {
+            out += PIECES[Pick(sizeof(PIECES) / sizeof(PIECES[0]))];
+        }
+        out.push_back('"');
+    }
+
+    void AppendNumber(std::string& out) {
+        static char const* const NUMBERS[] = {"0", "-0", "1", "-12", "3.25", "0.5", "1e3", "2E-2", "01", "1.",
+                "-", "12345678901234567890", "123456789012345", "9007199254740993", ".5"};
+        out += NUMBERS[Pick(sizeof(NUMBERS) / sizeof(NUMBERS[0]))];
+    }
+
+    void AppendValue(std::string& out, int depth) {
+        std::size_t kind = Pick(depth > 4 ? 5 : 7);
+        switch (kind) {
+            case 0:
+                AppendString(out);
+                break;
+            case 1:
+                AppendNumber(out);
+                break;
+            case 2:
+                out += "true";
+                break;
+            case 3:
+                out += "false";
+                break;
+            case 4:
+                out += "null";
+                break;
+            case 5:
+                AppendObject(out, depth + 1, false);
+                break;
+            default:
+                out.push_back('[');
+                for (std::size_t i = 0, n = Pick(4); i < n; ++i) {
+                    if (i > 0) {
+                        out.push_back(',');
+                    }
+                    AppendWhitespace(out);
+                    AppendValue(out, depth + 1);
+                    AppendWhitespace(out);
+                }
+                out.push_back(']');
+        }
+    }
+
+    void AppendObject(std::string& out, int depth, bool is_root) {
+        static char const* const KEYS[] = {"\"address\"", "\"amount\"", "\"addr\\u0065ss\"", "\"\"", "\"Address\""};
+        out.push_back('{');
+        for (std::size_t i = 0, n = Pick(4); i < n; ++i) {
+            if (i > 0) {
+                out.push_back(',');
+            }
+            AppendWhitespace(out);
+            out += is_root && Chance(60) ? "\"address\"" : KEYS[Pick(sizeof(KEYS) / sizeof(KEYS[0]))];
+            AppendWhitespace(out);
+            out.push_back(':');
+            AppendWhitespace(out);
+            if (is_root && Chance(50)) {
+                AppendString(out);
+            } else {
+                AppendValue(out, depth + 1);
+            }
+            AppendWhitespace(out);
+        }
+        out.push_back('}');
+    }
+
+    void Mutate(std::string& body) {
+        static char const NOISE[] = {'{', '}', '[', ']', '"', ',', ':', '/', '*', '\\', 'e', '0', '\0', '\x7f'};
+        if (body.empty()) {
+            return;
+        }
+        std::size_t pos = Pick(body.size());
+        switch (Pick(4)) {
+            case 0:
+                body.resize(pos);
+                break;
+            case 1:
+                body.erase(pos, 1);
+                break;
+            case 2:
+                body.insert(pos, 1, NOISE[Pick(sizeof(NOISE))]);
+                break;
+            default:
+                body[pos] = NOISE[Pick(sizeof(NOISE))];
+        }
+    }
+
+private:
+    std::mt19937 m_rng;
+};
+
+/// What the handler gets from jsoncpp alone
+bool ParseWithJsoncpp(std::string const& body, std::string& out_address, bool& out_found) {
+    static std::unique_ptr<Json::CharReader> reader(Json::CharReaderBuilder().newCharReader());
+    Json::Value root;
+    std::string errs;
+    if (!reader->parse(body.data(), body.data() + body.size(), &root, &errs)) {
+        return false;
+    }
+    out_found = root.isObject() && root["address"].isString();
+    if (out_found) {
+        out_address = root["address"].asString();
+    }
+    return true;
+}
+
+}  // namespace
+
+TEST_CASE("scanner reads the address of plain requests", "[request_scanner]") {
+    std::string address;
+    CHECK(RequestScanner::ScanAddress(R"({"address":"tb1qabc"})", address) == Result::Found);
+    CHECK(address == "tb1qabc");
+    CHECK(RequestScanner::ScanAddress(R"( {"amount": 1.5, "address" : "aA\n"} )", address) == Result::Found);
+    CHECK(address == "aA\n");
+    CHECK(RequestScanner::ScanAddress(R"({"address":"a","address":"b"})", address) == Result::Found);
+    CHECK(address == "b");
+    CHECK(RequestScanner::ScanAddress(R"({"address":"a","address":null})", address) == Result::NoAddress);
+    CHECK(RequestScanner::ScanAddress(R"({"addr":"a"})", address) == Result::NoAddress);
+    CHECK(RequestScanner::ScanAddress(R"(["address"])", address) == Result::NoAddress);
+    CHECK(RequestScanner::ScanAddress(R"({"address":"a"} // comment)", address) == Result::Fallback);
+    CHECK(RequestScanner::ScanAddress(R"({"amount":1e3,"address":"a"})", address) == Result::Fallback);
+    CHECK(RequestScanner::ScanAddress(R"({"address":"a")", address) == Result::Fallback);
+}
+
+TEST_CASE("scanner agrees with jsoncpp on random bodies", "[request_scanner]") {
+    BodyGenerator gen(20261016);
+    int num_scanned{0};
+    for (int i = 0; i < 50000; ++i) {
+        std::string body = gen.Next();
+        std::string scanned;
+        Result res = RequestScanner::ScanAddress(body, scanned);
+        if (res == Result::Fallback) {
+            continue;
+        }
+        ++num_scanned;
+        std::string parsed;
+        bool found{false};
+        INFO("body: " << body);
+        REQUIRE(ParseWithJsoncpp(body, parsed, found));
+        REQUIRE(found == (res == Result::Found));
+        if (found) {
+            REQUIRE(scanned == parsed);
+        }
+    }
+    // most of the bodies must be answered by the scanner, or the comparison proves little
+    CHECK(num_scanned > 20000);
+}
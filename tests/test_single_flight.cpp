@@ -0,0 +1,146 @@
+#include <catch2/catch.hpp>
+
+#include <asio.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "faucet_addr_man.h"
+#include "metrics.hpp"
+#include "payout_flights.hpp"
+#include "single_flight.hpp"
+
+namespace {
+
+std::string const ADDRESS = "tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx";
+
+}  // namespace
+
+TEST_CASE("the waiting callers get the result of the leader", "[single_flight]") {
+    SingleFlight<std::string, Metrics::Outcome, std::string> flights;
+    std::vector<Metrics::Outcome> outcomes;
+    auto callback = [&outcomes](Metrics::Outcome outcome, std::string const& content) {
+        CHECK(content == "cooling down");
+        outcomes.push_back(outcome);
+    };
+    REQUIRE(flights.Join(ADDRESS, callback));
+    REQUIRE_FALSE(flights.Join(ADDRESS, callback));
+    REQUIRE_FALSE(flights.Join(ADDRESS, callback));
+    CHECK(flights.Size() == 1);
+    flights.Complete(ADDRESS, Metrics::Outcome::Cooldown, "cooling down");
+    CHECK(flights.Size() == 0);
+    CHECK(outcomes == std::vector<Metrics::Outcome>(3, Metrics::Outcome::Cooldown));
+    // the next caller leads a new flight
+    CHECK(flights.Join(ADDRESS, callback));
+}
+
+TEST_CASE("concurrent requests of one address are paid once", "[single_flight]") {
+    int const NUM_THREADS = 8;
+    int const NUM_REQUESTS = 500;
+    FaucetAddrMan addr_man(std::chrono::seconds(3600));
+    asio::thread_pool rpc_pool(4);
+    std::atomic<int> num_payouts{0};
+    std::atomic<int> num_paid{0};
+    std::atomic<int> num_cooldown{0};
+    std::atomic<int> num_others{0};
+    auto check_cooldown = [&addr_man](std::string const& address, std::string& out_msg) {
+        if (addr_man.Query(address) == 0) {
+            return false;
+        }
+        out_msg = "cooling down";
+        return true;
+    };
+    // paid on the RPC pool and recorded before the callback, as the batcher does
+    PayoutFlights payouts(check_cooldown, [&](std::string const& address, PayoutFlights::PayCallback callback) {
+        asio::post(rpc_pool, [&, address, callback = std::move(callback)]() {
+            ++num_payouts;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            addr_man.Update(address);
+            callback(true, "txid");
+        });
+    });
+    auto reply = [&](Metrics::Outcome outcome, std::string const&) {
+        if (outcome == Metrics::Outcome::Paid) {
+            ++num_paid;
+        } else if (outcome == Metrics::Outcome::Cooldown) {
+            ++num_cooldown;
+        } else {
+            ++num_others;
+        }
+    };
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        threads.emplace_back([&]() {
+            while (!go) {
+                std::this_thread::yield();
+            }
+            for (int n = 0; n < NUM_REQUESTS; ++n) {
+                payouts.Request(ADDRESS, reply);
+            }
+        });
+    }
+    go = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    rpc_pool.join();
+    CHECK(num_payouts == 1);
+    CHECK(num_paid >= 1);
+    CHECK(num_paid + num_cooldown == NUM_THREADS * NUM_REQUESTS);
+    CHECK(num_others == 0);
+    CHECK(payouts.NumInFlight() == 0);
+}
+
+TEST_CASE("a failed payout is reported to every request of its flight", "[single_flight]") {
+    PayoutFlights::PayCallback pending;
+    PayoutFlights payouts([](std::string const&, std::string&) { return false; },
+            [&pending](std::string const&, PayoutFlights::PayCallback callback) { pending = std::move(callback); });
+    std::vector<Metrics::Outcome> outcomes;
+    auto reply = [&outcomes](Metrics::Outcome outcome, std::string const& content) {
+        CHECK(content == "insufficient funds");
+        outcomes.push_back(outcome);
+    };
+    payouts.Request(ADDRESS, reply);
+    payouts.Request(ADDRESS, reply);
+    REQUIRE(pending);
+    CHECK(payouts.NumInFlight() == 1);
+    pending(false, "insufficient funds");
+    CHECK(outcomes == std::vector<Metrics::Outcome>(2, Metrics::Outcome::RpcError));
+    CHECK(payouts.NumInFlight() == 0);
+}
+
+TEST_CASE("a flight finished between the check and the join is not paid again", "[single_flight]") {
+    FaucetAddrMan addr_man(std::chrono::seconds(3600));
+    int num_payouts{0};
+    PayoutFlights::PayCallback pending;
+    bool finish_in_check{false};
+    // finishes the payout in flight right after the address is seen out of cooldown
+    auto check_cooldown = [&](std::string const& address, std::string& out_msg) {
+        bool cooling_down = addr_man.Query(address) != 0;
+        if (finish_in_check && pending) {
+            finish_in_check = false;
+            addr_man.Update(address);
+            std::exchange(pending, nullptr)(true, "txid");
+        }
+        out_msg = "cooling down";
+        return cooling_down;
+    };
+    PayoutFlights payouts(check_cooldown, [&](std::string const&, PayoutFlights::PayCallback callback) {
+        ++num_payouts;
+        pending = std::move(callback);
+    });
+    std::vector<Metrics::Outcome> outcomes;
+    auto reply = [&outcomes](Metrics::Outcome outcome, std::string const&) { outcomes.push_back(outcome); };
+    payouts.Request(ADDRESS, reply);
+    REQUIRE(num_payouts == 1);
+    finish_in_check = true;
+    payouts.Request(ADDRESS, reply);
+    CHECK(num_payouts == 1);
+    CHECK(outcomes == std::vector<Metrics::Outcome>{Metrics::Outcome::Paid, Metrics::Outcome::Cooldown});
+    CHECK(payouts.NumInFlight() == 0);
+}
@@ -0,0 +1,463 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <asio.hpp>
+#include <cxxopts.hpp>
+
+#include "address.h"
+#include "utils.hpp"
+
+using asio::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Sends the fund requests at a fixed rate, the requests which cannot be sent on time are queued. The latency is
+ * measured from the time a request is scheduled, so a slow server cannot hide its latency by slowing down the sender.
+ */
+class LoadGen {
+public:
+    struct Options {
+        tcp::endpoint endpoint;
+        double rps{100};
+        std::chrono::seconds duration{10};
+        int connections{64};
+        bool keep_alive{true};
+        double reuse{0};
+    };
+
+    LoadGen(asio::io_context& ioc, Options opts)
+        : m_ioc(ioc), m_opts(opts), m_timer(ioc), m_rng(std::random_device()()) {}
+
+    void Start() {
+        m_start = Clock::now();
+        Tick();
+    }
+
+    void Report() const {
+        double secs = std::chrono::duration<double>(m_end - m_start).count();
+        std::vector<double> latencies = m_latencies;
+        std::sort(std::begin(latencies), std::end(latencies));
+        auto percentile = [&latencies](double p) -> double {
+            if (latencies.empty()) {
+                return 0;
+            }
+            std::size_t index = std::min(latencies.size() - 1, static_cast<std::size_t>(p * latencies.size()));
+            return latencies[index];
+        };
+        printf("scheduled:  %zu\n", m_num_scheduled);
+        printf("completed:  %zu\n", latencies.size());
+        printf("failed:     %zu\n", m_num_failed);
+        printf("in flight:  %d\n", m_num_busy);
+        printf("unsent:     %zu\n", m_pending.size());
+        for (auto const& status : m_statuses) {
+            printf("status %d: %zu\n", status.first, status.second);
+        }
+        printf("throughput: %.1f req/s\n", secs > 0 ? latencies.size() / secs : 0);
+        printf("latency p50: %.3f ms, p99: %.3f ms, p999: %.3f ms, max: %.3f ms\n", percentile(0.5),
+                percentile(0.99), percentile(0.999), latencies.empty() ? 0 : latencies.back());
+    }
+
+private:
+    static constexpr std::chrono::seconds DRAIN_TIMEOUT{10};
+
+    struct Connection {
+        explicit Connection(asio::io_context& ioc) : s(ioc) {}
+
+        tcp::socket s;
+        bool connected{false};
+        std::string request;
+        std::string response;
+        char buf[4096];
+        Clock::time_point scheduled;
+    };
+
+    void Tick() {
+        auto now = Clock::now();
+        bool done = now - m_start >= m_opts.duration;
+        auto elapsed = std::chrono::duration<double>(std::min<Clock::duration>(now - m_start, m_opts.duration));
+        auto due = static_cast<std::size_t>(elapsed.count() * m_opts.rps);
+        for (; m_num_scheduled < due; ++m_num_scheduled) {
+            auto scheduled = m_start + std::chrono::duration_cast<Clock::duration>(
+                                               std::chrono::duration<double>(m_num_scheduled / m_opts.rps));
+            m_pending.push_back(scheduled);
+        }
+        Pump();
+        if (done) {
+            m_end = Clock::now();
+            m_draining = true;
+            Finish();
+            // the requests which are never answered are reported as in flight
+            m_timer.expires_after(DRAIN_TIMEOUT);
+            m_timer.async_wait([this](std::error_code const& ec) {
+                if (!ec) {
+                    m_ioc.stop();
+                }
+            });
+            return;
+        }
+        m_timer.expires_after(std::chrono::milliseconds(1));
+        m_timer.async_wait([this](std::error_code const& ec) {
+            if (!ec) {
+                Tick();
+            }
+        });
+    }
+
+    void Pump() {
+        while (!m_pending.empty() && !m_draining) {
+            std::unique_ptr<Connection> conn;
+            if (!m_idle.empty()) {
+                conn = std::move(m_idle.back());
+                m_idle.pop_back();
+            } else if (m_num_busy < m_opts.connections) {
+                conn = std::make_unique<Connection>(m_ioc);
+            } else {
+                break;
+            }
+            conn->scheduled = m_pending.front();
+            m_pending.pop_front();
+            ++m_num_busy;
+            Send(std::move(conn));
+        }
+    }
+
+    void Send(std::unique_ptr<Connection> conn) {
+        conn->request = MakeRequest(NextAddress());
+        conn->response.clear();
+        if (conn->connected) {
+            Write(std::move(conn));
+            return;
+        }
+        auto& s = conn->s;
+        s.async_connect(m_opts.endpoint, [this, conn = std::move(conn)](std::error_code const& ec) mutable {
+            if (ec) {
+                Fail(std::move(conn));
+                return;
+            }
+            conn->connected = true;
+            Write(std::move(conn));
+        });
+    }
+
+    void Write(std::unique_ptr<Connection> conn) {
+        auto& c = *conn;
+        asio::async_write(c.s, asio::buffer(c.request),
+                [this, conn = std::move(conn)](std::error_code const& ec, std::size_t) mutable {
+                    if (ec) {
+                        Fail(std::move(conn));
+                        return;
+                    }
+                    Read(std::move(conn));
+                });
+    }
+
+    void Read(std::unique_ptr<Connection> conn) {
+        auto& c = *conn;
+        c.s.async_read_some(asio::buffer(c.buf), [this, conn = std::move(conn)](
+                                                         std::error_code const& ec, std::size_t total_read) mutable {
+            if (ec) {
+                Fail(std::move(conn));
+                return;
+            }
+            conn->response.append(conn->buf, total_read);
+            int status;
+            bool close;
+            if (!ParseResponse(conn->response, status, close)) {
+                Read(std::move(conn));
+                return;
+            }
+            m_latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - conn->scheduled).count());
+            ++m_statuses[status];
+            if (close || !m_opts.keep_alive) {
+                asio::error_code ignored_ec;
+                conn->s.close(ignored_ec);
+                conn->connected = false;
+            }
+            Release(std::move(conn));
+        });
+    }
+
+    void Fail(std::unique_ptr<Connection> conn) {
+        ++m_num_failed;
+        asio::error_code ignored_ec;
+        conn->s.close(ignored_ec);
+        conn->connected = false;
+        Release(std::move(conn));
+    }
+
+    void Release(std::unique_ptr<Connection> conn) {
+        --m_num_busy;
+        if (conn->connected) {
+            m_idle.push_back(std::move(conn));
+        }
+        if (m_draining) {
+            Finish();
+        } else {
+            Pump();
+        }
+    }
+
+    /// Stop once the requests in flight are answered, the queued ones are reported as unsent
+    void Finish() {
+        if (m_num_busy == 0) {
+            m_idle.clear();
+            m_ioc.stop();
+        }
+    }
+
+    /// @return true when the whole response is received
+    static bool ParseResponse(std::string const& response, int& status, bool& close) {
+        auto header_end = response.find("\r\n\r\n");
+        if (header_end == std::string::npos) {
+            return false;
+        }
+        std::string_view head = std::string_view(response).substr(0, header_end);
+        auto sp = head.find(' ');
+        if (sp == std::string_view::npos) {
+            status = 0;
+        } else {
+            status = atoi(std::string(head.substr(sp + 1, 3)).c_str());
+        }
+        std::size_t content_length{0};
+        close = false;
+        std::size_t pos = head.find("\r\n");
+        while (pos != std::string_view::npos) {
+            std::size_t next = head.find("\r\n", pos + 2);
+            std::string_view line = head.substr(pos + 2, next == std::string_view::npos ? next : next - pos - 2);
+            auto colon = line.find(':');
+            if (colon != std::string_view::npos) {
+                std::string_view name = line.substr(0, colon);
+                std::string_view value = TrimString(line.substr(colon + 1));
+                if (EqualsIgnoreCase(name, "Content-Length")) {
+                    content_length = strtoul(std::string(value).c_str(), nullptr, 10);
+                } else if (EqualsIgnoreCase(name, "Connection")) {
+                    close = EqualsIgnoreCase(value, "close");
+                }
+            }
+            pos = next;
+        }
+        return response.size() >= header_end + 4 + content_length;
+    }
+
+    std::string MakeRequest(std::string const& address) const {
+        std::string body = "{\"address\":\"" + address + "\"}";
+        std::string req;
+        req += "POST / HTTP/1.1\r\n";
+        req += "Host: " + m_opts.endpoint.address().to_string() + "\r\n";
+        req += "Content-Type: application/json\r\n";
+        req += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        req += m_opts.keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+        req += "\r\n";
+        req += body;
+        return req;
+    }
+
+    /// A funded address is requested again with the probability `reuse`, otherwise a new address is generated
+    std::string NextAddress() {
+        if (!m_addresses.empty() && std::bernoulli_distribution(m_opts.reuse)(m_rng)) {
+            std::uniform_int_distribution<std::size_t> index(0, m_addresses.size() - 1);
+            return m_addresses[index(m_rng)];
+        }
+        // valid P2WPKH addresses, the faucet rejects anything else before the cooldown check
+        Bytes program(20);
+        uint64_t index = m_addresses.size();
+        for (int i = 0; i < 8; ++i) {
+            program[i] = static_cast<uint8_t>(index >> (i * 8));
+        }
+        m_addresses.push_back(EncodeSegwitAddress(AddressParams::Testnet3().hrp, 0, program));
+        return m_addresses.back();
+    }
+
+private:
+    asio::io_context& m_ioc;
+    Options m_opts;
+    asio::steady_timer m_timer;
+    std::mt19937_64 m_rng;
+    Clock::time_point m_start;
+    Clock::time_point m_end;
+    std::size_t m_num_scheduled{0};
+    std::size_t m_num_failed{0};
+    int m_num_busy{0};
+    bool m_draining{false};
+    std::deque<Clock::time_point> m_pending;
+    std::vector<std::unique_ptr<Connection>> m_idle;
+    std::vector<std::string> m_addresses;
+    std::vector<double> m_latencies;
+    std::map<int, std::size_t> m_statuses;
+};
+
+/**
+ * Slow-loris clients: every connection sends a request line and then one more header byte now and then without ever
+ * finishing the headers. The faucet has to time them out or shed them while the load is still served on time.
+ */
+class StalledClients {
+public:
+    StalledClients(asio::io_context& ioc, tcp::endpoint endpoint, int num, std::chrono::milliseconds trickle)
+        : m_ioc(ioc), m_endpoint(endpoint), m_num(num), m_trickle(trickle) {}
+
+    void Start() {
+        for (int i = 0; i < m_num; ++i) {
+            m_clients.push_back(std::make_unique<Client>(m_ioc));
+            Connect(*m_clients.back());
+        }
+    }
+
+    void Report() const {
+        std::vector<double> lifetimes;
+        std::size_t num_shed{0}, num_open{0}, num_failed{0};
+        for (auto const& client : m_clients) {
+            if (client->state == State::Closed) {
+                lifetimes.push_back(std::chrono::duration<double>(client->closed - client->connected).count());
+            } else if (client->state == State::Shed) {
+                ++num_shed;
+            } else if (client->state == State::Failed) {
+                ++num_failed;
+            } else {
+                ++num_open;
+            }
+        }
+        std::sort(std::begin(lifetimes), std::end(lifetimes));
+        printf("stalled:    %d\n", m_num);
+        printf("  closed:   %zu", lifetimes.size());
+        if (!lifetimes.empty()) {
+            printf(" (lifetime p50: %.2f s, max: %.2f s)", lifetimes[lifetimes.size() / 2], lifetimes.back());
+        }
+        printf("\n  shed:     %zu\n", num_shed);
+        printf("  failed:   %zu\n", num_failed);
+        printf("  open:     %zu\n", num_open);
+    }
+
+private:
+    enum class State { Connecting, Open, Closed, Shed, Failed };
+
+    struct Client {
+        explicit Client(asio::io_context& ioc) : s(ioc), timer(ioc) {}
+
+        tcp::socket s;
+        asio::steady_timer timer;
+        State state{State::Connecting};
+        std::size_t num_sent{0};
+        std::string response;
+        char buf[256];
+        Clock::time_point connected;
+        Clock::time_point closed;
+    };
+
+    void Connect(Client& client) {
+        client.s.async_connect(m_endpoint, [this, &client](std::error_code const& ec) {
+            if (ec) {
+                client.state = State::Failed;
+                return;
+            }
+            client.state = State::Open;
+            client.connected = Clock::now();
+            Read(client);
+            Trickle(client);
+        });
+    }
+
+    /// The first call sends the request line, the following ones a byte of a header which never ends
+    void Trickle(Client& client) {
+        static std::string const head = "POST / HTTP/1.1\r\nX-Stall: ";
+        std::size_t size = client.num_sent == 0 ? head.size() : 1;
+        char const* data = client.num_sent == 0 ? head.data() : "a";
+        asio::async_write(client.s, asio::buffer(data, size), [this, &client](std::error_code const& ec, std::size_t) {
+            if (ec || client.state != State::Open) {
+                return;
+            }
+            ++client.num_sent;
+            client.timer.expires_after(m_trickle);
+            client.timer.async_wait([this, &client](std::error_code const& ec) {
+                if (!ec && client.state == State::Open) {
+                    Trickle(client);
+                }
+            });
+        });
+    }
+
+    /// Anything from the faucet ends the client, it is either the reply of a shed connection or the end of file
+    void Read(Client& client) {
+        client.s.async_read_some(asio::buffer(client.buf), [this, &client](std::error_code const& ec, std::size_t n) {
+            if (!ec) {
+                client.response.append(client.buf, n);
+                Read(client);
+                return;
+            }
+            client.state = client.response.compare(0, 12, "HTTP/1.1 503") == 0 ? State::Shed : State::Closed;
+            client.closed = Clock::now();
+            client.timer.cancel();
+        });
+    }
+
+    asio::io_context& m_ioc;
+    tcp::endpoint m_endpoint;
+    int m_num;
+    std::chrono::milliseconds m_trickle;
+    std::vector<std::unique_ptr<Client>> m_clients;
+};
+
+int main(int argc, char const* argv[]) {
+    cxxopts::Options opts("faucet-loadgen", "Send fund requests to the faucet at a fixed rate and report the latency.");
+    opts.add_options()                      // All options here
+            ("help", "Show help document")  // --help
+            ("addr", "The address of the faucet",
+             cxxopts::value<std::string>()->default_value("127.0.0.1"))  // --addr
+            ("port", "The port of the faucet",
+             cxxopts::value<unsigned short>()->default_value("18080"))  // --port
+            ("rps", "How many requests are sent per second",
+             cxxopts::value<double>()->default_value("100"))  // --rps
+            ("duration-secs", "How long the requests are sent",
+             cxxopts::value<int>()->default_value("10"))  // --duration-secs
+            ("connections", "How many connections can be opened at the same time",
+             cxxopts::value<int>()->default_value("64"))  // --connections
+            ("no-keep-alive", "Open a new connection for every request")  // --no-keep-alive
+            ("reuse", "The probability of requesting an address which has been requested before",
+             cxxopts::value<double>()->default_value("0"))  // --reuse
+            ("stalled", "How many slow-loris connections are opened before the load starts",
+             cxxopts::value<int>()->default_value("0"))  // --stalled
+            ("trickle-ms", "How often a slow-loris connection sends one more byte of its headers",
+             cxxopts::value<int>()->default_value("1000"))  // --trickle-ms
+            ("stall-secs", "How long the slow-loris connections are held before the load starts",
+             cxxopts::value<int>()->default_value("1"))  // --stall-secs
+            ;
+    auto result = opts.parse(argc, argv);
+    if (result.count("help")) {
+        std::cout << opts.help() << std::endl;
+        return 0;
+    }
+    LoadGen::Options gen_opts;
+    gen_opts.endpoint = tcp::endpoint(
+            asio::ip::address::from_string(result["addr"].as<std::string>()), result["port"].as<unsigned short>());
+    gen_opts.rps = std::max(1.0, result["rps"].as<double>());
+    gen_opts.duration = std::chrono::seconds(result["duration-secs"].as<int>());
+    gen_opts.connections = std::max(1, result["connections"].as<int>());
+    gen_opts.keep_alive = result.count("no-keep-alive") == 0;
+    gen_opts.reuse = std::clamp(result["reuse"].as<double>(), 0.0, 1.0);
+
+    int num_stalled = std::max(0, result["stalled"].as<int>());
+
+    asio::io_context ioc;
+    StalledClients stalled(
+            ioc, gen_opts.endpoint, num_stalled, std::chrono::milliseconds(result["trickle-ms"].as<int>()));
+    LoadGen gen(ioc, gen_opts);
+    asio::steady_timer start_timer(ioc);
+    stalled.Start();
+    // the load is measured while the faucet is already holding the stalled connections
+    start_timer.expires_after(std::chrono::seconds(num_stalled > 0 ? result["stall-secs"].as<int>() : 0));
+    start_timer.async_wait([&gen](std::error_code const&) { gen.Start(); });
+    ioc.run();
+    gen.Report();
+    if (num_stalled > 0) {
+        stalled.Report();
+    }
+    return 0;
+}
@@ -0,0 +1,411 @@
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+#include <plog/Log.h>
+#include <plog/Initializers/ConsoleInitializer.h>
+#include <plog/Appenders/ConsoleAppender.h>
+#include <plog/Formatters/TxtFormatter.h>
+
+#include <json/json.h>
+
+#include "address.h"
+#include "faucet_service.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+/**
+ * Answers the JSON-RPC calls of the faucet like a btchd wallet with unlimited funds, so the faucet can be load tested
+ * offline. Every call is delayed by `latency` plus a random `jitter` and payments fail with the probability `error_rate`.
+ *
+ * The wallet has unlimited funds and only tracks the coins sent to its own addresses from `getnewaddress`, which is
+ * enough for the raw transactions of the utxo pool. A raw transaction is the hex of a json with its inputs and outputs.
+ */
+class MockNode {
+public:
+    static const int64_t COIN = 100000000;
+
+    struct Options {
+        std::chrono::milliseconds latency{0};
+        std::chrono::milliseconds jitter{0};
+        double error_rate{0};
+        double balance{1000000};
+        std::chrono::milliseconds block_time{0};
+        bool locked{false};
+        bool initial_block_download{false};
+    };
+
+    MockNode(asio::io_context& ioc, Options opts)
+        : m_ioc(ioc), m_opts(opts), m_locked(opts.locked), m_rng(std::random_device()()) {}
+
+    void Handle(std::shared_ptr<Session> const& psession, SimpleHttpMessageParser const& parser) {
+        std::string_view body = parser.ReadBody();
+        Json::CharReaderBuilder builder;
+        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+        Json::Value root;
+        std::string errs;
+        int status{200};
+        Json::Value res;
+        if (!reader->parse(body.data(), body.data() + body.size(), &root, &errs)) {
+            res = MakeError(Json::Value(), -32700, "Parse error");
+            status = 500;
+        } else if (root.isArray()) {
+            // the batch itself succeeds, each call carries its own result or error
+            res = Json::Value(Json::arrayValue);
+            for (auto const& call : root) {
+                res.append(Call(call));
+            }
+        } else {
+            res = Call(root);
+            // btchd replies the failed calls with an error status
+            if (!res["error"].isNull()) {
+                status = 500;
+            }
+        }
+        Json::StreamWriterBuilder writer;
+        writer["indentation"] = "";
+        SimpleHttpMessageBuilder msg_builder(psession->KeepAlive());
+        msg_builder.WriteContent(Json::writeString(writer, res), "application/json", status);
+        auto timer = std::make_shared<asio::steady_timer>(m_ioc, NextDelay());
+        timer->async_wait([timer, psession, msg = msg_builder.TakeMessage()](std::error_code const&) mutable {
+            psession->Write(std::move(msg));
+        });
+    }
+
+private:
+    Json::Value Call(Json::Value const& call) {
+        Json::Value id = call.isObject() ? call["id"] : Json::Value();
+        if (!call.isObject() || !call["method"].isString()) {
+            return MakeError(id, -32600, "Invalid Request");
+        }
+        std::string method = call["method"].asString();
+        Json::Value const& params = call["params"];
+        if (method == "getbalance") {
+            return MakeResult(id, m_opts.balance);
+        }
+        if (method == "getblockchaininfo") {
+            Json::Value info;
+            info["chain"] = "test";
+            info["blocks"] = 100000;
+            info["initialblockdownload"] = m_opts.initial_block_download;
+            return MakeResult(id, info);
+        }
+        if (method == "getwalletinfo") {
+            Json::Value info;
+            info["walletname"] = "";
+            info["balance"] = m_opts.balance;
+            // the wallet is encrypted, it is unlocked until the mock is stopped
+            info["unlocked_until"] = m_locked ? 0 : std::numeric_limits<int>::max();
+            return MakeResult(id, info);
+        }
+        if (method == "walletlock" || method == "walletpassphrase") {
+            m_locked = method == "walletlock";
+            PLOG_INFO << "The wallet is " << (m_locked ? "locked" : "unlocked");
+            return MakeResult(id, Json::Value());
+        }
+        bool spends = method == "sendtoaddress" || method == "sendmany" || method == "signrawtransactionwithwallet";
+        if (m_locked && spends) {
+            return MakeError(id, -13, "Error: Please enter the wallet passphrase with walletpassphrase first.");
+        }
+        if (!params.isArray()) {
+            return MakeError(id, -1, "invalid parameters of " + method);
+        }
+        if (method == "sendtoaddress" || method == "sendmany") {
+            if (params.size() < 2) {
+                return MakeError(id, -1, "invalid parameters of " + method);
+            }
+            if (NextError()) {
+                return MakeError(id, -6, "Insufficient funds");
+            }
+            std::string txid = NextTxid();
+            if (method == "sendmany") {
+                std::lock_guard lock(m_wallet_mtx);
+                int vout{0};
+                for (auto const& address : params[1].getMemberNames()) {
+                    AddCoin({txid, vout++}, address, ParseAmount(params[1][address]));
+                }
+            }
+            return MakeResult(id, txid);
+        }
+        if (method == "getnewaddress") {
+            std::string address = NextAddress();
+            std::lock_guard lock(m_wallet_mtx);
+            m_labels[address] = params.empty() ? "" : params[0].asString();
+            return MakeResult(id, address);
+        }
+        if (method == "listunspent") {
+            int min_conf = params.size() > 0 ? params[0].asInt() : 1;
+            int max_conf = params.size() > 1 ? params[1].asInt() : 9999999;
+            return MakeResult(id, ListUnspent(min_conf, max_conf));
+        }
+        if (method == "createrawtransaction") {
+            if (params.size() < 2 || !params[0].isArray() || !params[1].isObject()) {
+                return MakeError(id, -8, "invalid parameters of createrawtransaction");
+            }
+            // the mock transaction is the compact json of its inputs and outputs
+            Json::Value tx;
+            tx["inputs"] = params[0];
+            tx["outputs"] = params[1];
+            Json::StreamWriterBuilder writer;
+            writer["indentation"] = "";
+            std::string str = Json::writeString(writer, tx);
+            return MakeResult(id, BytesToHex(Bytes(std::begin(str), std::end(str))));
+        }
+        if (method == "signrawtransactionwithwallet") {
+            Json::Value tx;
+            if (params.empty() || !DecodeTx(params[0].asString(), tx)) {
+                return MakeError(id, -22, "TX decode failed");
+            }
+            Json::Value res;
+            res["hex"] = params[0];
+            std::lock_guard lock(m_wallet_mtx);
+            res["complete"] = HasInputs(tx);
+            return MakeResult(id, res);
+        }
+        if (method == "sendrawtransaction") {
+            Json::Value tx;
+            if (params.empty() || !DecodeTx(params[0].asString(), tx)) {
+                return MakeError(id, -22, "TX decode failed");
+            }
+            if (NextError()) {
+                return MakeError(id, -26, "min relay fee not met");
+            }
+            return SendRawTransaction(id, tx);
+        }
+        return MakeError(id, -32601, "Method not found");
+    }
+
+    struct Coin {
+        std::string address;
+        int64_t amount;
+        std::chrono::steady_clock::time_point created;
+    };
+
+    using Outpoint = std::pair<std::string, int>;
+
+    /// Only the outputs to the addresses of the wallet are kept, the wallet must be locked
+    void AddCoin(Outpoint outpoint, std::string const& address, int64_t amount) {
+        if (m_labels.count(address)) {
+            m_coins[std::move(outpoint)] = {address, amount, std::chrono::steady_clock::now()};
+        }
+    }
+
+    /// A coin is confirmed once `block_time` is elapsed, the mock never goes deeper than one confirmation
+    Json::Value ListUnspent(int min_conf, int max_conf) {
+        auto now = std::chrono::steady_clock::now();
+        Json::Value res(Json::arrayValue);
+        std::lock_guard lock(m_wallet_mtx);
+        for (auto const& entry : m_coins) {
+            int confirmations = now - entry.second.created >= m_opts.block_time ? 1 : 0;
+            if (confirmations < min_conf || confirmations > max_conf) {
+                continue;
+            }
+            Json::Value unspent;
+            unspent["txid"] = entry.first.first;
+            unspent["vout"] = entry.first.second;
+            unspent["address"] = entry.second.address;
+            unspent["label"] = m_labels[entry.second.address];
+            unspent["amount"] = static_cast<double>(entry.second.amount) / COIN;
+            unspent["confirmations"] = confirmations;
+            unspent["spendable"] = true;
+            res.append(unspent);
+        }
+        return res;
+    }
+
+    /// The wallet must be locked
+    bool HasInputs(Json::Value const& tx) const {
+        for (auto const& input : tx["inputs"]) {
+            if (!m_coins.count({input["txid"].asString(), input["vout"].asInt()})) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Json::Value SendRawTransaction(Json::Value const& id, Json::Value const& tx) {
+        std::lock_guard lock(m_wallet_mtx);
+        if (!HasInputs(tx)) {
+            return MakeError(id, -25, "bad-txns-inputs-missingorspent");
+        }
+        int64_t value_in{0};
+        for (auto const& input : tx["inputs"]) {
+            value_in += m_coins[{input["txid"].asString(), input["vout"].asInt()}].amount;
+        }
+        int64_t value_out{0};
+        for (auto const& address : tx["outputs"].getMemberNames()) {
+            value_out += ParseAmount(tx["outputs"][address]);
+        }
+        if (value_out > value_in) {
+            return MakeError(id, -26, "bad-txns-in-belowout");
+        }
+        for (auto const& input : tx["inputs"]) {
+            m_coins.erase({input["txid"].asString(), input["vout"].asInt()});
+        }
+        std::string txid = NextTxid();
+        int vout{0};
+        for (auto const& address : tx["outputs"].getMemberNames()) {
+            AddCoin({txid, vout++}, address, ParseAmount(tx["outputs"][address]));
+        }
+        return MakeResult(id, txid);
+    }
+
+    static bool DecodeTx(std::string const& hex, Json::Value& out_tx) {
+        if (hex.size() % 2 != 0) {
+            return false;
+        }
+        std::string str;
+        for (std::size_t i = 0; i < hex.size(); i += 2) {
+            str.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+        }
+        Json::CharReaderBuilder builder;
+        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+        std::string errs;
+        return reader->parse(str.data(), str.data() + str.size(), &out_tx, &errs) && out_tx.isObject();
+    }
+
+    /// Amounts are either numbers or decimal strings
+    static int64_t ParseAmount(Json::Value const& amount) {
+        double value = amount.isString() ? std::stod(amount.asString()) : amount.asDouble();
+        return std::llround(value * COIN);
+    }
+
+    static Json::Value MakeResult(Json::Value const& id, Json::Value result) {
+        Json::Value res;
+        res["result"] = std::move(result);
+        res["error"] = Json::Value();
+        res["id"] = id;
+        return res;
+    }
+
+    static Json::Value MakeError(Json::Value const& id, int code, std::string const& message) {
+        Json::Value res;
+        res["result"] = Json::Value();
+        res["error"]["code"] = code;
+        res["error"]["message"] = message;
+        res["id"] = id;
+        return res;
+    }
+
+    std::chrono::milliseconds NextDelay() {
+        std::lock_guard lock(m_rng_mtx);
+        std::uniform_int_distribution<int64_t> jitter(0, m_opts.jitter.count());
+        return m_opts.latency + std::chrono::milliseconds(jitter(m_rng));
+    }
+
+    bool NextError() {
+        std::lock_guard lock(m_rng_mtx);
+        return std::bernoulli_distribution(m_opts.error_rate)(m_rng);
+    }
+
+    std::string NextAddress() {
+        std::lock_guard lock(m_rng_mtx);
+        Bytes program(20);
+        for (auto& b : program) {
+            b = static_cast<uint8_t>(m_rng());
+        }
+        return EncodeSegwitAddress(AddressParams::Testnet3().hrp, 0, program);
+    }
+
+    std::string NextTxid() {
+        std::lock_guard lock(m_rng_mtx);
+        Bytes txid(32);
+        for (auto& b : txid) {
+            b = static_cast<uint8_t>(m_rng());
+        }
+        return BytesToHex(txid);
+    }
+
+private:
+    asio::io_context& m_ioc;
+    Options m_opts;
+    std::atomic<bool> m_locked;
+    std::mutex m_rng_mtx;
+    std::mt19937_64 m_rng;
+    std::mutex m_wallet_mtx;
+    std::map<std::string, std::string> m_labels;
+    std::map<Outpoint, Coin> m_coins;
+};
+
+int main(int argc, char const* argv[]) {
+    cxxopts::Options opts("btchd-mock-node", "Serve the wallet RPC of btchd which is used by the faucet.");
+    opts.add_options()                      // All options here
+            ("help", "Show help document")  // --help
+            ("addr", "Service will bind to this address",
+             cxxopts::value<std::string>()->default_value("127.0.0.1"))  // --addr
+            ("port", "Service will bind to this port",
+             cxxopts::value<unsigned short>()->default_value("18732"))  // --port
+            ("verbose", "Show more logs for debugging purpose")         // --verbose
+            ("threads", "How many threads are used to run the service",
+             cxxopts::value<int>()->default_value("1"))  // --threads
+            ("latency-ms", "How long each RPC call takes",
+             cxxopts::value<int>()->default_value("0"))  // --latency-ms
+            ("jitter-ms", "A random delay up to this value is added to each RPC call",
+             cxxopts::value<int>()->default_value("0"))  // --jitter-ms
+            ("error-rate", "The probability of a payment to fail with `Insufficient funds`",
+             cxxopts::value<double>()->default_value("0"))  // --error-rate
+            ("balance", "The balance returned by `getbalance` and `getwalletinfo`",
+             cxxopts::value<double>()->default_value("1000000"))  // --balance
+            ("block-ms", "How long a new coin of the wallet stays unconfirmed",
+             cxxopts::value<int>()->default_value("0"))  // --block-ms
+            ("locked", "Start with the wallet locked, `walletpassphrase` and `walletlock` switch it")  // --locked
+            ("ibd", "Report the node in initial block download")                                      // --ibd
+            ;
+    auto result = opts.parse(argc, argv);
+    if (result.count("help")) {
+        std::cout << opts.help() << std::endl;
+        return 0;
+    }
+    auto log_type = result.count("verbose") ? plog::Severity::debug : plog::Severity::info;
+    plog::ConsoleAppender<plog::TxtFormatter> appender;
+    plog::init(log_type, &appender);
+
+    MockNode::Options node_opts;
+    node_opts.latency = std::chrono::milliseconds(result["latency-ms"].as<int>());
+    node_opts.jitter = std::chrono::milliseconds(result["jitter-ms"].as<int>());
+    node_opts.error_rate = result["error-rate"].as<double>();
+    node_opts.balance = result["balance"].as<double>();
+    node_opts.block_time = std::chrono::milliseconds(result["block-ms"].as<int>());
+    node_opts.locked = result.count("locked") > 0;
+    node_opts.initial_block_download = result.count("ibd") > 0;
+
+    std::string addr = result["addr"].as<std::string>();
+    unsigned short port = result["port"].as<unsigned short>();
+    PLOG_INFO << "Mock node is listening on " << addr << ", port " << port;
+    tcp::endpoint endpoint(asio::ip::address::from_string(addr), port);
+
+    // the faucet keeps its connections to the node, they are never closed by the mock
+    ServiceOptions service_opts;
+    service_opts.max_requests_per_conn = std::numeric_limits<int>::max();
+    service_opts.max_sessions = 0;
+    service_opts.idle_timeout = std::chrono::seconds(0);
+
+    asio::io_context ioc;
+    MockNode node(ioc, node_opts);
+    Service service(
+            ioc, endpoint,
+            [&node](std::shared_ptr<Session> const& psession, SimpleHttpMessageParser const& parser) {
+                node.Handle(psession, parser);
+            },
+            service_opts);
+    int num_threads = std::max(1, result["threads"].as<int>());
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; ++i) {
+        threads.emplace_back([&ioc]() { ioc.run(); });
+    }
+    ioc.run();
+    for (auto& t : threads) {
+        t.join();
+    }
+    return 0;
+}